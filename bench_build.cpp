@@ -0,0 +1,115 @@
+//
+//  bench_build.cpp
+//  Fusion Tree
+//
+//  measures how long it takes to build fusion tree nodes and a fusion B-tree
+//  over random elements, with the construction that compares adjacent elements
+//  and with the pairwise construction of the first version, and prints the
+//  speedup of the first over the second. Then builds the B-tree again with the
+//  threads of a bulk_builder, to compare the cold start with the serial one
+//
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "big_int.hpp"
+#include "bulk_builder.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+
+// returns a random integer with the given number of bits
+static big_int random_element(mt19937 &rng, int bits) {
+  big_int x = 0;
+  for (int i = 0; i < bits; i += 31) {
+    x <<= 31;
+    x |= big_int(int(rng() & 0x7fffffff));
+  }
+  return x & ((big_int(1) << bits) - big_int(1));
+}
+
+// returns the seconds passed since start
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// build times of a construction mode
+struct build_times {
+  double node_time;  // seconds to build all the nodes
+  double tree_time;  // seconds to build the B-tree
+  int levels;        // levels of the B-tree
+};
+
+// builds a node over each set of elements, and a B-tree over elements, in
+// the environment env, and returns how long they took
+static build_times time_builds(const environment *env,
+                               vector<vector<big_int> > &node_elements,
+                               vector<big_int> &elements) {
+  build_times res;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < (int)node_elements.size(); i++) {
+    fusiontree node(node_elements[i], env);
+  }
+  res.node_time = seconds_since(start);
+
+  start = chrono::steady_clock::now();
+  fusion_btree tree(elements, env);
+  res.tree_time = seconds_since(start);
+  res.levels = tree.levels();
+  return res;
+}
+
+int main() {
+  environment env;
+  environment pairwise_env(env.word_size, env.element_size, env.capacity,
+                           env.sketching, pairwise_construction);
+  mt19937 rng(2021);
+
+  // sets of capacity random elements, one for each node
+  const int nodes = 200;
+  vector<vector<big_int> > node_elements(nodes);
+  for (int i = 0; i < nodes; i++) {
+    for (int j = 0; j < env.capacity; j++) {
+      node_elements[i].push_back(random_element(rng, env.element_size));
+    }
+  }
+
+  // a B-tree with many levels
+  const int count = 2000;
+  vector<big_int> elements;
+  for (int i = 0; i < count; i++) {
+    elements.push_back(random_element(rng, env.element_size));
+  }
+
+  build_times adjacent = time_builds(&env, node_elements, elements);
+  build_times pairwise = time_builds(&pairwise_env, node_elements, elements);
+
+  // the same B-tree with the threads of a builder, which are started before
+  // the clock
+  vector<int> thread_counts = {1, 2, 4};
+  int hardware_threads = thread::hardware_concurrency();
+  if (hardware_threads > 4) thread_counts.push_back(hardware_threads);
+  vector<double> parallel_times;
+  for (int threads : thread_counts) {
+    bulk_builder builder(&env, threads);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    fusion_btree parallel_tree(elements, &env, builder);
+    parallel_times.push_back(seconds_since(start));
+  }
+
+  cout << "fusiontree build: " << adjacent.node_time * 1e6 / nodes
+       << " us/node, pairwise " << pairwise.node_time * 1e6 / nodes
+       << " us/node (speedup " << pairwise.node_time / adjacent.node_time
+       << ", " << nodes << " nodes of " << env.capacity << " elements)"
+       << endl;
+  cout << "fusion_btree build: " << adjacent.tree_time * 1e3
+       << " ms, pairwise " << pairwise.tree_time * 1e3 << " ms (speedup "
+       << pairwise.tree_time / adjacent.tree_time << ", " << count
+       << " elements, " << adjacent.levels << " levels)" << endl;
+  for (int i = 0; i < (int)thread_counts.size(); i++) {
+    cout << "fusion_btree build with " << thread_counts[i]
+         << " threads: " << parallel_times[i] * 1e3 << " ms (speedup "
+         << adjacent.tree_time / parallel_times[i] << ")" << endl;
+  }
+}
@@ -0,0 +1,366 @@
+//
+//  bench_queries.cpp
+//  Fusion Tree
+//
+//  compares the predecessor queries of fusiontree and fusion_btree with a
+//  binary search in a sorted array, std::set and a search in the Eytzinger
+//  (breadth-first) layout of the sorted array, which is cache friendly as the
+//  van Emde Boas layout. Each configuration is a word size, an element size, a
+//  capacity and a distribution of the keys. For each of them and each
+//  structure, it prints a CSV line with the build time, the percentiles of the
+//  latency of single queries and the throughput of a batch of queries. The
+//  B-tree is measured over basic_environment, which reads its bitmasks from
+//  tables, and over static_environment, which computes them from their index.
+//  "bench_queries.exe quick" runs fewer queries
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "static_environment.hpp"
+
+using namespace std;
+
+// distributions of the keys
+enum distribution {
+  uniform,    // all the bits are random
+  clustered,  // keys close to one of a few random centers
+  prefix      // keys that share all but their lowest 64 bits
+};
+
+const char *distribution_names[] = {"uniform", "clustered", "prefix"};
+
+// sizes of a run
+struct bench_size {
+  int keys;     // number of keys in the B-tree and the baselines
+  int nodes;    // number of fusion tree nodes built and queried
+  int queries;  // number of queries timed one by one, and in the batch
+};
+
+// returns the seconds passed since start
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// returns a random integer with the given number of bits
+template <int Bits>
+static basic_big_int<Bits> random_bits(mt19937_64 &rng, int bits) {
+  basic_big_int<Bits> x = 0;
+  for (int i = 0; i < bits; i += 31) {
+    x <<= 31;
+    x |= basic_big_int<Bits>(int(rng() & 0x7fffffff));
+  }
+  return x & ((basic_big_int<Bits>(1) << bits) - basic_big_int<Bits>(1));
+}
+
+// generates keys of element_size bits from a distribution
+template <int Bits>
+class key_generator {
+ private:
+  typedef basic_big_int<Bits> word;
+
+  mt19937_64 rng;
+  distribution dist;
+  int element_size;
+  vector<word> centers;  // centers of the clusters
+  word common;           // prefix shared by all the keys
+
+ public:
+  key_generator(distribution dist_, int element_size_, uint64_t seed)
+      : rng(seed), dist(dist_), element_size(element_size_) {
+    for (int i = 0; i < 8; i++) {
+      centers.push_back(random_bits<Bits>(rng, element_size));
+    }
+    common = random_bits<Bits>(rng, element_size) >> 64 << 64;
+  }
+
+  word next() {
+    if (dist == clustered) {
+      // a center with its lowest 40 bits changed
+      return (centers[rng() % centers.size()] >> 40 << 40) |
+             random_bits<Bits>(rng, 40);
+    }
+    if (dist == prefix) {
+      return common | random_bits<Bits>(rng, min(64, element_size));
+    }
+    return random_bits<Bits>(rng, element_size);
+  }
+
+  // returns n distinct keys in increasing order
+  vector<word> sorted_keys(int n) {
+    set<word> keys;
+    while ((int)keys.size() < n) keys.insert(next());
+    return vector<word>(keys.begin(), keys.end());
+  }
+};
+
+// sorted array in the Eytzinger layout: the root in position 1 and the
+// children of position k in positions 2k and 2k+1, with the rank of each key
+template <class word>
+class eytzinger_array {
+ private:
+  vector<word> keys;
+  vector<int> ranks;
+
+  // fills the subtree of position k with the sorted keys from position i on
+  void fill(const vector<word> &sorted, int &i, int k) {
+    if (k >= (int)keys.size()) return;
+    fill(sorted, i, 2 * k);
+    keys[k] = sorted[i];
+    ranks[k] = i++;
+    fill(sorted, i, 2 * k + 1);
+  }
+
+ public:
+  eytzinger_array(const vector<word> &sorted)
+      : keys(sorted.size() + 1), ranks(sorted.size() + 1) {
+    int i = 0;
+    fill(sorted, i, 1);
+  }
+
+  // returns the rank of the largest key not larger than x, or -1
+  int find_predecessor(const word &x) const {
+    int n = keys.size() - 1;
+    int k = 1;
+    while (k <= n) k = 2 * k + (keys[k] <= x ? 1 : 0);
+    // k went right below the last key larger than x, so it is the first one
+    // after the right turns at the end of the path
+    k >>= __builtin_ffs(~k);
+    return k == 0 ? n - 1 : ranks[k] - 1;
+  }
+};
+
+// prints the line of a structure, with the percentiles of the latencies of
+// the single queries and the throughput of the batch, which took
+// batch_seconds for all the queries
+static void report(const char *config, const char *structure, int keys,
+                   double build_seconds, const vector<double> &latencies,
+                   double batch_seconds) {
+  vector<double> sorted = latencies;
+  sort(sorted.begin(), sorted.end());
+  int n = sorted.size();
+  printf("%s,%s,%d,%.3f,%.1f,%.1f,%.1f,%.4f\n", config, structure, keys,
+         build_seconds * 1e6, sorted[n / 2] * 1e9, sorted[n * 9 / 10] * 1e9,
+         sorted[min(n - 1, n * 99 / 100)] * 1e9, n / batch_seconds / 1e6);
+}
+
+// sum of the answers of the last batch
+volatile long long answers_sum;
+
+// answers the queries one at a time with find, timing each of them, and then
+// all of them together, and checks the answers against expected
+template <class word, class F>
+static void measure(const vector<word> &queries, const vector<int> &expected,
+                    F find, vector<double> &latencies, double &batch_seconds) {
+  latencies.clear();
+  int errors = 0;
+  for (int i = 0; i < (int)queries.size(); i++) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int answer = find(queries[i]);
+    latencies.push_back(seconds_since(start));
+    if (answer != expected[i]) errors++;
+  }
+
+  // the sum of the answers is kept, so that the queries are not optimized out
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  long long sum = 0;
+  for (int i = 0; i < (int)queries.size(); i++) sum += find(queries[i]);
+  batch_seconds = seconds_since(start);
+  answers_sum = sum;
+
+  if (errors > 0) {
+    fprintf(stderr, "%d wrong answers\n", errors);
+    exit(1);
+  }
+}
+
+// runs every structure over one configuration
+template <int Bits, int ElementSize, int Capacity>
+static void run(distribution dist, const bench_size &size) {
+  typedef basic_big_int<Bits> word;
+  typedef basic_environment<word> env_type;
+  typedef static_environment<Bits, ElementSize, Capacity> static_env_type;
+  typedef basic_fusiontree<word, env_type> fusiontree_type;
+  typedef basic_fusion_btree<word, env_type> btree_type;
+  typedef basic_fusion_btree<word, static_env_type> static_btree_type;
+  const int element_size = ElementSize, capacity = Capacity;
+
+  char config[64];
+  snprintf(config, sizeof(config), "%d,%d,%d,%s", Bits, element_size, capacity,
+           distribution_names[dist]);
+
+  env_type env(Bits, element_size, capacity);
+  static_env_type static_env;
+  key_generator<Bits> gen(dist, element_size, 2021);
+  vector<double> latencies;
+  double batch_seconds;
+
+  // fusion tree nodes, each queried with its own keys and random keys
+  {
+    vector<vector<word> > node_keys;
+    for (int i = 0; i < size.nodes; i++) {
+      node_keys.push_back(gen.sorted_keys(capacity));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<fusiontree_type> nodes;
+    for (int i = 0; i < size.nodes; i++) {
+      nodes.push_back(fusiontree_type(node_keys[i], &env));
+    }
+    double build_seconds = seconds_since(start) / size.nodes;
+
+    vector<word> queries;
+    vector<int> owner, expected;
+    mt19937_64 rng(7);
+    for (int i = 0; i < size.queries; i++) {
+      int node = rng() % size.nodes;
+      const vector<word> &keys = node_keys[node];
+      word x = i % 2 ? keys[rng() % capacity] : gen.next();
+      queries.push_back(x);
+      owner.push_back(node);
+      expected.push_back(int(upper_bound(keys.begin(), keys.end(), x) -
+                             keys.begin()) -
+                         1);
+    }
+    // the queries are answered in order, so the node of each one is the next
+    int next = 0;
+    measure(queries, expected,
+            [&](const word &x) {
+              int node = owner[next];
+              next = (next + 1) % size.queries;
+              return nodes[node].find_predecessor(x);
+            },
+            latencies, batch_seconds);
+    report(config, "fusiontree", capacity, build_seconds, latencies,
+           batch_seconds);
+  }
+
+  // the B-tree and the baselines over the same keys
+  vector<word> keys = gen.sorted_keys(size.keys);
+  vector<word> queries;
+  vector<int> expected;
+  mt19937_64 rng(11);
+  for (int i = 0; i < size.queries; i++) {
+    word x = i % 2 ? keys[rng() % keys.size()] : gen.next();
+    queries.push_back(x);
+    expected.push_back(
+        int(upper_bound(keys.begin(), keys.end(), x) - keys.begin()) - 1);
+  }
+
+  {
+    vector<word> input = keys;
+    shuffle(input.begin(), input.end(), rng);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    btree_type tree(input, &env);
+    double build_seconds = seconds_since(start);
+
+    measure(queries, expected,
+            [&](const word &x) { return tree.find_predecessor(x); },
+            latencies, batch_seconds);
+    // the batch is answered with find_predecessor_batch instead
+    vector<int> out(queries.size());
+    start = chrono::steady_clock::now();
+    tree.find_predecessor_batch(queries.data(), queries.size(), out.data());
+    batch_seconds = seconds_since(start);
+    if (out != expected) {
+      fprintf(stderr, "wrong answers in find_predecessor_batch\n");
+      exit(1);
+    }
+    report(config, "fusion_btree", keys.size(), build_seconds, latencies,
+           batch_seconds);
+  }
+
+  {
+    // the same B-tree over static_environment, whose bitmasks are not read
+    // from tables
+    vector<word> input = keys;
+    shuffle(input.begin(), input.end(), rng);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    static_btree_type tree(input, &static_env);
+    double build_seconds = seconds_since(start);
+
+    measure(queries, expected,
+            [&](const word &x) { return tree.find_predecessor(x); },
+            latencies, batch_seconds);
+    vector<int> out(queries.size());
+    start = chrono::steady_clock::now();
+    tree.find_predecessor_batch(queries.data(), queries.size(), out.data());
+    batch_seconds = seconds_since(start);
+    if (out != expected) {
+      fprintf(stderr, "wrong answers in find_predecessor_batch\n");
+      exit(1);
+    }
+    report(config, "fusion_btree_static", keys.size(), build_seconds,
+           latencies, batch_seconds);
+  }
+
+  {
+    vector<word> input = keys;
+    shuffle(input.begin(), input.end(), rng);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    sort(input.begin(), input.end());
+    double build_seconds = seconds_since(start);
+
+    measure(queries, expected,
+            [&](const word &x) {
+              return int(upper_bound(input.begin(), input.end(), x) -
+                         input.begin()) -
+                     1;
+            },
+            latencies, batch_seconds);
+    report(config, "sorted_array", keys.size(), build_seconds, latencies,
+           batch_seconds);
+
+    start = chrono::steady_clock::now();
+    eytzinger_array<word> layout(input);
+    build_seconds = seconds_since(start);
+    measure(queries, expected,
+            [&](const word &x) { return layout.find_predecessor(x); },
+            latencies, batch_seconds);
+    report(config, "eytzinger", keys.size(), build_seconds, latencies,
+           batch_seconds);
+  }
+
+  {
+    // std::set does not give ranks, so the position of each key is kept with
+    // it, as the payload of a map would be
+    vector<pair<word, int> > input;
+    for (int i = 0; i < (int)keys.size(); i++) input.push_back({keys[i], i});
+    shuffle(input.begin(), input.end(), rng);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    set<pair<word, int> > tree(input.begin(), input.end());
+    double build_seconds = seconds_since(start);
+
+    measure(queries, expected,
+            [&](const word &x) {
+              typename set<pair<word, int> >::const_iterator it =
+                  tree.upper_bound(make_pair(x, int(keys.size())));
+              return it == tree.begin() ? -1 : prev(it)->second;
+            },
+            latencies, batch_seconds);
+    report(config, "std_set", keys.size(), build_seconds, latencies,
+           batch_seconds);
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_size size = {2000, 200, 2000};
+  if (argc > 1 and strcmp(argv[1], "quick") == 0) size = {500, 50, 200};
+
+  printf(
+      "word_bits,element_size,capacity,distribution,structure,keys,build_us,"
+      "p50_ns,p90_ns,p99_ns,batch_mqps\n");
+  for (int d = 0; d < 3; d++) {
+    run<1024, 256, 3>(distribution(d), size);
+    run<2048, 1024, 4>(distribution(d), size);
+    run<WSIZE, 3136, 5>(distribution(d), size);
+  }
+}
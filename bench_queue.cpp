@@ -0,0 +1,147 @@
+//
+//  bench_queue.cpp
+//  Fusion Tree
+//
+//  compares fusion_queue with std::priority_queue over the same big_int
+//  priorities, of the 3136 bits of the default environment. Each run pushes n
+//  random priorities, and then decreases the priority of a random entry and
+//  pops the smallest one n times. std::priority_queue has no decrease_key, so
+//  it pushes the entry again with its new priority and skips the stale copies
+//  when they reach the top, as Dijkstra's algorithm usually does. For each n
+//  it prints a CSV line with the time of each phase in each queue.
+//  "bench_queue.exe quick" runs a smaller n
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_queue.hpp"
+
+using namespace std;
+
+// priority and handle of an entry of std::priority_queue
+typedef pair<big_int, int> heap_entry;
+typedef priority_queue<heap_entry, vector<heap_entry>, greater<heap_entry> >
+    binary_heap;
+
+// times of the phases of a run, in seconds
+struct run_times {
+  double push, decrease_pop;
+};
+
+// returns the seconds passed since start
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// returns a random integer with the given number of bits, a limb at a time
+static big_int random_bits(mt19937_64 &rng, int bits) {
+  uint64_t limbs[big_int::limb_count];
+  for (int i = 0; i < big_int::limb_count; i++) limbs[i] = rng();
+  big_int x(limbs, big_int::limb_count);
+  return x & ((big_int(1) << bits) - big_int(1));
+}
+
+// returns the priority x lowered by a random amount below 2^31
+static big_int lowered(mt19937_64 &rng, const big_int &x) {
+  big_int delta(int(rng() & 0x7fffffff));
+  return x < delta ? big_int(0) : big_int(x - delta);
+}
+
+// runs the fusion_queue and keeps the popped priorities in popped
+static run_times run_fusion_queue(const vector<big_int> &priorities,
+                                  const environment *env,
+                                  vector<big_int> &popped) {
+  int n = priorities.size();
+  fusion_queue queue(env);
+  mt19937_64 rng(7);
+  run_times times;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) queue.push(priorities[i]);
+  times.push = seconds_since(start);
+
+  // the handles are 0 to n - 1, since none was freed while pushing
+  vector<bool> alive(n, true);
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    int handle = rng() % n;
+    if (alive[handle]) {
+      queue.decrease_key(handle, lowered(rng, queue.priority(handle)));
+    }
+    popped.push_back(queue.peek_min());
+    alive[queue.pop_min()] = false;
+  }
+  times.decrease_pop = seconds_since(start);
+  return times;
+}
+
+// runs std::priority_queue and keeps the popped priorities in popped
+static run_times run_binary_heap(const vector<big_int> &priorities,
+                                 vector<big_int> &popped) {
+  int n = priorities.size();
+  binary_heap heap;
+  vector<big_int> current = priorities;
+  vector<bool> alive(n, true);
+  mt19937_64 rng(7);
+  run_times times;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) heap.push(heap_entry(priorities[i], i));
+  times.push = seconds_since(start);
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    int handle = rng() % n;
+    if (alive[handle]) {
+      current[handle] = lowered(rng, current[handle]);
+      heap.push(heap_entry(current[handle], handle));
+    }
+    // skips the copies of entries whose priority was decreased
+    while (!alive[heap.top().second] or
+           heap.top().first != current[heap.top().second]) {
+      heap.pop();
+    }
+    popped.push_back(heap.top().first);
+    alive[heap.top().second] = false;
+    heap.pop();
+  }
+  times.decrease_pop = seconds_since(start);
+  return times;
+}
+
+int main(int argc, char **argv) {
+  vector<int> sizes = {1000, 10000};
+  if (argc > 1 and strcmp(argv[1], "quick") == 0) sizes = {1000};
+  environment *env = new environment;
+
+  printf(
+      "entries,fusion_push_ms,fusion_decrease_pop_ms,heap_push_ms,"
+      "heap_decrease_pop_ms\n");
+  for (int s = 0; s < (int)sizes.size(); s++) {
+    mt19937_64 rng(2021);
+    vector<big_int> priorities;
+    for (int i = 0; i < sizes[s]; i++) {
+      priorities.push_back(random_bits(rng, env->element_size));
+    }
+
+    vector<big_int> fusion_popped, heap_popped;
+    run_times fusion = run_fusion_queue(priorities, env, fusion_popped);
+    run_times heap = run_binary_heap(priorities, heap_popped);
+    if (fusion_popped != heap_popped) {
+      fprintf(stderr, "the queues popped different priorities\n");
+      return 1;
+    }
+    printf("%d,%.2f,%.2f,%.2f,%.2f\n", sizes[s], fusion.push * 1e3,
+           fusion.decrease_pop * 1e3, heap.push * 1e3,
+           heap.decrease_pop * 1e3);
+  }
+  delete env;
+}
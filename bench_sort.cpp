@@ -0,0 +1,105 @@
+//
+//  bench_sort.cpp
+//  Fusion Tree
+//
+//  compares fusion_sort with std::sort over the same big_int keys, of the 3136
+//  bits of the default environment. For each number of keys and distribution
+//  of the keys, it prints a CSV line with the time of each sort and the
+//  speedup of fusion_sort. "bench_sort.exe quick" sorts fewer keys
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_sort.hpp"
+
+using namespace std;
+
+// distributions of the keys
+enum distribution {
+  uniform,    // all the bits are random
+  clustered,  // keys close to one of a few random centers
+  prefix,     // keys that share all but their lowest 64 bits
+  repeated    // keys taken from a few hundred distinct ones
+};
+
+const char *distribution_names[] = {"uniform", "clustered", "prefix",
+                                    "repeated"};
+
+// returns the seconds passed since start
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// returns a random integer with the given number of bits, a limb at a time
+static big_int random_bits(mt19937_64 &rng, int bits) {
+  uint64_t limbs[big_int::limb_count];
+  for (int i = 0; i < big_int::limb_count; i++) limbs[i] = rng();
+  big_int x(limbs, big_int::limb_count);
+  return x & ((big_int(1) << bits) - big_int(1));
+}
+
+// returns n keys of the given number of bits from a distribution
+static vector<big_int> make_keys(int n, int bits, distribution dist) {
+  mt19937_64 rng(2021);
+  vector<big_int> centers;
+  int center_count = dist == repeated ? 300 : 8;
+  for (int i = 0; i < center_count; i++) {
+    centers.push_back(random_bits(rng, bits));
+  }
+  big_int common = random_bits(rng, bits) >> 64 << 64;
+
+  vector<big_int> keys;
+  keys.reserve(n);
+  for (int i = 0; i < n; i++) {
+    if (dist == clustered) {
+      // a center with its lowest 40 bits changed
+      keys.push_back((centers[rng() % center_count] >> 40 << 40) |
+                     random_bits(rng, 40));
+    } else if (dist == prefix) {
+      keys.push_back(common | random_bits(rng, 64));
+    } else if (dist == repeated) {
+      keys.push_back(centers[rng() % center_count]);
+    } else {
+      keys.push_back(random_bits(rng, bits));
+    }
+  }
+  return keys;
+}
+
+int main(int argc, char **argv) {
+  vector<int> sizes = {10000, 100000};
+  if (argc > 1 and strcmp(argv[1], "quick") == 0) sizes = {10000};
+  const int bits = environment().element_size;
+
+  printf("keys,distribution,std_sort_ms,fusion_sort_ms,speedup\n");
+  for (int s = 0; s < (int)sizes.size(); s++) {
+    for (int d = 0; d < 4; d++) {
+      vector<big_int> keys = make_keys(sizes[s], bits, distribution(d));
+
+      vector<big_int> expected = keys;
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      sort(expected.begin(), expected.end());
+      double std_seconds = seconds_since(start);
+
+      vector<big_int> sorted = keys;
+      start = chrono::steady_clock::now();
+      fusion_sort(sorted);
+      double fusion_seconds = seconds_since(start);
+
+      if (sorted != expected) {
+        fprintf(stderr, "fusion_sort gave a wrong order\n");
+        return 1;
+      }
+      printf("%d,%s,%.2f,%.2f,%.3f\n", sizes[s], distribution_names[d],
+             std_seconds * 1e3, fusion_seconds * 1e3,
+             std_seconds / fusion_seconds);
+    }
+  }
+}
@@ -8,59 +8,1192 @@
 #ifndef big_int_hpp
 #define big_int_hpp
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <bitset>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "op_counter.hpp"
 
 #define PSIZE 4000   // Number of bits printed in cout << big_int
 #define PINTERV 100  // Number of bits in printing intervals
 #define WSIZE 4000   // Size the big_int must have - O(max(K^5+K^4,w+sqrt(w))
+#define LSIZE 64     // Size of each limb of the big_int, in bits
+
+// adds two limbs and an incoming carry, keeps the sum in *out and returns the
+// outgoing carry. On x86-64 it compiles to a single adc instruction
+static inline unsigned char add_with_carry(unsigned char carry, uint64_t a,
+                                           uint64_t b, uint64_t *out) {
+#if defined(__x86_64__)
+  return _addcarry_u64(carry, a, b,
+                       reinterpret_cast<unsigned long long *>(out));
+#else
+  uint64_t sum = a + carry;
+  unsigned char res = (sum < a);
+  *out = sum + b;
+  return res | (*out < sum);
+#endif
+}
+
+// subtracts a limb and an incoming borrow from another limb, keeps the
+// difference in *out and returns the outgoing borrow. On x86-64 it compiles to
+// a single sbb instruction
+static inline unsigned char sub_with_borrow(unsigned char borrow, uint64_t a,
+                                            uint64_t b, uint64_t *out) {
+#if defined(__x86_64__)
+  return _subborrow_u64(borrow, a, b,
+                        reinterpret_cast<unsigned long long *>(out));
+#else
+  uint64_t diff = a - b;
+  unsigned char res = (a < b);
+  *out = diff - borrow;
+  return res | (diff < uint64_t(borrow));
+#endif
+}
+
+// returns true if the processor running the program supports the BMI2
+// instructions. It is checked at runtime, so that the same binary also runs on
+// processors without them
+static inline bool cpu_supports_bmi2() {
+#if defined(__x86_64__)
+  static const bool supported = __builtin_cpu_supports("bmi2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// returns true if the processor running the program supports the AVX2
+// instructions, checked at runtime as cpu_supports_bmi2
+static inline bool cpu_supports_avx2() {
+#if defined(__x86_64__)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// order of the bytes of an integer kept in a byte array: the least significant
+// byte first, or the most significant one first, as in network order
+enum byte_order { little_endian_order, big_endian_order };
+
+// reads the 8 bytes at p as a 64-bit integer in the given byte order. They are
+// loaded with a single memcpy, which may be unaligned, and swapped if the
+// order is not the one of the machine
+static inline uint64_t load_limb(const uint8_t *p, byte_order order) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return order == little_endian_order ? x : __builtin_bswap64(x);
+#else
+  return order == big_endian_order ? x : __builtin_bswap64(x);
+#endif
+}
+
+// writes x to the 8 bytes at p in the given byte order
+static inline void store_limb(uint64_t x, uint8_t *p, byte_order order) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (order == big_endian_order) x = __builtin_bswap64(x);
+#else
+  if (order == little_endian_order) x = __builtin_bswap64(x);
+#endif
+  memcpy(p, &x, sizeof(x));
+}
+
+#if defined(__x86_64__)
+// gathers the bits of the n limbs of x selected by the limbs of mask into the
+// low bits of the result, in order, with one pext instruction per limb. It may
+// only be called if cpu_supports_bmi2()
+__attribute__((target("bmi2"))) static inline uint64_t parallel_extract_limbs(
+    const uint64_t *x, const uint64_t *mask, int n) {
+  uint64_t res = 0;
+  int offset = 0;
+  for (int i = 0; i < n; i++) {
+    if (mask[i] == 0) continue;
+    res |= _pext_u64(x[i], mask[i]) << offset;
+    offset += __builtin_popcountll(mask[i]);
+  }
+  return res;
+}
+#endif
+
+template <int Bits>
+class basic_big_int;
+
+// base of the expressions over big_ints of Bits bits, whose type is E. An
+// expression is not evaluated when it is built. Its limbs are computed one at
+// a time, only when it is assigned to a big_int, compared or converted to int,
+// so a chain of bitwise operators, shifts, additions and subtractions makes a
+// single pass over the limbs instead of building a big_int for each operator.
+// The type E provides:
+//   limb(i): the limb i of the value, with the bits beyond Bits clear;
+//   refers_to(p): whether the expression reads the big_int at address p;
+//   reads_shifted(p): whether it reads the big_int at p in limbs other than
+//   the one being computed, so that it cannot be assigned to it in place;
+//   sequential: whether its limbs must be read once each, from the least
+//   significant one, because a carry goes from each limb to the next.
+// An expression keeps references to the big_ints it reads, so it must be used
+// in the statement that builds it, and never kept in an auto variable
+template <int Bits, class E>
+class big_int_expr {
+ public:
+  const E &self() const { return static_cast<const E &>(*this); }
+
+  // the value of the least significant limb, which is the only one read
+  explicit operator int() const { return int(self().limb(0)); }
+};
+
+// the expressions built by the operators of basic_big_int, defined below
+template <int Bits, class A, class B, class Op>
+class big_int_bitwise;
+template <int Bits, class A>
+class big_int_not;
+template <int Bits, class A, bool Left>
+class big_int_shift;
+template <int Bits, class A, class B, bool Subtract>
+class big_int_sum;
+template <int Bits>
+class big_int_shifted_mask;
+
+// operations of big_int_bitwise on a pair of limbs
+struct big_int_and {
+  static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+};
+struct big_int_or {
+  static uint64_t apply(uint64_t a, uint64_t b) { return a | b; }
+};
+struct big_int_xor {
+  static uint64_t apply(uint64_t a, uint64_t b) { return a ^ b; }
+};
+
+// unsigned integer of Bits bits. All the arithmetic is done modulo 2^Bits, as
+// it would be in a machine word of that size. A big_int is also the simplest
+// expression, whose limbs are its own
+template <int Bits>
+class basic_big_int : public big_int_expr<Bits, basic_big_int<Bits> > {
+ public:
+  static const int bits = Bits;  // size of the integer, in bits
+  static const int limb_count = (Bits + LSIZE - 1) / LSIZE;  // number of limbs
 
-class big_int {
  private:
-  std::bitset<WSIZE> bs;
+  uint64_t limbs[limb_count];  // limbs of the integer, least significant first
+
+  // clears the bits of the most significant limb that lie beyond Bits
+  void clear_padding();
+
+  // returns the number of limbs up to the most significant non-zero limb
+  int used_limbs() const;
+
+  // adds x << shift to *this in place, touching only the limbs x occupies
+  void add_shifted(const basic_big_int &x, int shift);
+
+  friend class sparse_multiplier;
 
  public:
-  operator int() const;
+  explicit operator int() const;
   int word_size() const;
 
-  big_int(int x = 0);
+  // returns the index of the most significant set bit, or -1 if the integer
+  // is zero, using count leading zeros over the limbs
+  int most_significant_bit() const;
+
+  // returns the index of the most significant bit in which *this and x
+  // differ, or -1 if they are equal, without building *this ^ x
+  int first_diff(const basic_big_int &x) const;
+
+  // returns the index of the least significant set bit in position i or
+  // above, or -1 if there is none, using count trailing zeros over the limbs
+  int next_set_bit(int i) const;
+
+  // returns the index of the least significant clear bit in position i or
+  // above, or -1 if there is none below Bits
+  int next_clear_bit(int i) const;
+
+  // sets bit i, without building a mask for it
+  void set_bit(int i);
+
+  // gathers the bits of *this selected by mask into the low bits of the
+  // result, keeping their order. mask may have at most 64 set bits. Uses pext
+  // when the processor supports BMI2
+  uint64_t extract_bits(const basic_big_int &mask) const;
+
+  basic_big_int(int x = 0);
+
+  basic_big_int(const std::bitset<Bits> &b);
+
+  // builds the integer from n limbs, the least significant first. Limbs
+  // beyond limb_count and bits beyond Bits are dropped, and missing limbs are
+  // zero
+  basic_big_int(const uint64_t *x, int n);
+
+  // builds the integer from n bytes in the given order, a whole limb at a
+  // time. As with the limbs, the bytes above Bits are dropped
+  basic_big_int(const uint8_t *bytes, size_t n, byte_order order);
+
+  // returns the integer written in hexadecimal, with an optional "0x" prefix.
+  // Digits above Bits are dropped. Throws a string if a character is not a
+  // hexadecimal digit
+  static basic_big_int from_hex(const std::string &hex);
+
+  // writes the n least significant limbs into x, with zeros after limb_count
+  void to_limbs(uint64_t *x, int n) const;
+
+  // writes the n least significant bytes into bytes, in the given order, with
+  // zeros above Bits
+  void to_bytes(uint8_t *bytes, size_t n, byte_order order) const;
+
+  // returns the integer in lowercase hexadecimal, without leading zeros
+  std::string to_hex() const;
+
+  // returns the limbs of the integer, the least significant first
+  const uint64_t *data() const { return limbs; }
+
+  // returns count consecutive integers read in place from a buffer of
+  // count * limb_count limbs, without copying them. The buffer must stay
+  // alive while the integers are used. Throws a string if the buffer is not
+  // aligned to 8 bytes, or if an integer has a bit set above Bits, since the
+  // operators expect these bits to be clear
+  static const basic_big_int *view(const uint64_t *x, size_t count = 1);
+
+  // evaluates an expression, in a single pass over the limbs
+  template <class E>
+  basic_big_int(const big_int_expr<Bits, E> &e);
+
+  // evaluates an expression into *this. If the expression reads *this in other
+  // limbs, as a shift of *this does, it is evaluated into a new big_int first
+  template <class E>
+  basic_big_int &operator=(const big_int_expr<Bits, E> &e);
+
+  // members read by the expressions, see big_int_expr
+  static const bool sequential = false;
+  uint64_t limb(int i) const { return limbs[i]; }
+  bool refers_to(const void *p) const { return p == this; }
+  bool reads_shifted(const void *p) const { return false; }
+
+  // returns the bits of limb i that lie below Bits
+  static uint64_t limb_mask(int i);
+
+  // the bitwise operators, shifts, additions, subtractions and comparisons of
+  // big_ints are the ones of expressions, defined outside the class. They
+  // return expressions that are only evaluated when they are used
+
+  basic_big_int operator-() const;
+
+  // in place versions of the operators, which change *this instead of
+  // building a new big_int. The bitwise operators, the addition and the
+  // subtraction take any expression, and read it in the same pass in which
+  // *this is changed
+
+  basic_big_int &operator<<=(const int x);
+
+  basic_big_int &operator>>=(const int x);
+
+  template <class E>
+  basic_big_int &operator|=(const big_int_expr<Bits, E> &x);
+
+  template <class E>
+  basic_big_int &operator&=(const big_int_expr<Bits, E> &x);
+
+  template <class E>
+  basic_big_int &operator^=(const big_int_expr<Bits, E> &x);
+
+  template <class E>
+  basic_big_int &operator+=(const big_int_expr<Bits, E> &x);
+
+  template <class E>
+  basic_big_int &operator-=(const big_int_expr<Bits, E> &x);
+
+  basic_big_int &operator*=(const basic_big_int &x);
+};
+
+// the big integer used by default, of size WSIZE
+typedef basic_big_int<WSIZE> big_int;
+
+// type in which an expression keeps its operand of type E. A big_int is kept
+// by reference, and any other expression, which only holds references and
+// shift amounts, by value
+template <int Bits, class E>
+struct big_int_operand {
+  typedef const E type;
+};
+
+template <int Bits>
+struct big_int_operand<Bits, basic_big_int<Bits> > {
+  typedef const basic_big_int<Bits> &type;
+};
+
+// type in which an expression of type E is read when its limbs are needed out
+// of order, as by a shift or a comparison. A sequential expression is
+// evaluated into a big_int first
+template <int Bits, class E, bool sequential = E::sequential>
+struct big_int_random_access {
+  typedef typename big_int_operand<Bits, E>::type type;
+};
+
+template <int Bits, class E>
+struct big_int_random_access<Bits, E, true> {
+  typedef const basic_big_int<Bits> type;
+};
+
+// bitwise operation Op between the limbs of two expressions
+template <int Bits, class A, class B, class Op>
+class big_int_bitwise
+    : public big_int_expr<Bits, big_int_bitwise<Bits, A, B, Op> > {
+ private:
+  typename big_int_operand<Bits, A>::type a;
+  typename big_int_operand<Bits, B>::type b;
+
+ public:
+  static const bool sequential = A::sequential or B::sequential;
+
+  big_int_bitwise(const A &a_, const B &b_) : a(a_), b(b_) {}
+
+  uint64_t limb(int i) const { return Op::apply(a.limb(i), b.limb(i)); }
+  bool refers_to(const void *p) const {
+    return a.refers_to(p) or b.refers_to(p);
+  }
+  bool reads_shifted(const void *p) const {
+    return a.reads_shifted(p) or b.reads_shifted(p);
+  }
+};
+
+// complement of an expression
+template <int Bits, class A>
+class big_int_not : public big_int_expr<Bits, big_int_not<Bits, A> > {
+ private:
+  typename big_int_operand<Bits, A>::type a;
+
+ public:
+  static const bool sequential = A::sequential;
+
+  big_int_not(const A &a_) : a(a_) {}
+
+  uint64_t limb(int i) const {
+    return ~a.limb(i) & basic_big_int<Bits>::limb_mask(i);
+  }
+  bool refers_to(const void *p) const { return a.refers_to(p); }
+  bool reads_shifted(const void *p) const { return a.reads_shifted(p); }
+};
+
+// expression shifted to the left, if Left is true, or to the right. Each limb
+// is made of the two limbs of the operand it straddles. As in a bitset,
+// shifting by a negative amount or by Bits or more bits gives zero
+template <int Bits, class A, bool Left>
+class big_int_shift : public big_int_expr<Bits, big_int_shift<Bits, A, Left> > {
+ private:
+  typename big_int_random_access<Bits, A>::type a;
+  int limb_shift, bit_shift;  // the shift amount in whole limbs and in the
+                              // remaining bits. limb_shift is limb_count if
+                              // the result is zero
+
+ public:
+  static const bool sequential = false;
+
+  big_int_shift(const A &a_, int x) : a(a_) {
+    if (x < 0 or x >= Bits) x = basic_big_int<Bits>::limb_count * LSIZE;
+    limb_shift = x / LSIZE;
+    bit_shift = x % LSIZE;
+  }
+
+  uint64_t limb(int i) const {
+    const int n = basic_big_int<Bits>::limb_count;
+    uint64_t res = 0;
+    if (Left) {
+      int j = i - limb_shift;
+      if (j >= 0) res = a.limb(j) << bit_shift;
+      if (bit_shift != 0 and j - 1 >= 0) {
+        res |= a.limb(j - 1) >> (LSIZE - bit_shift);
+      }
+      return res & basic_big_int<Bits>::limb_mask(i);
+    }
+    int j = i + limb_shift;
+    if (j < n) res = a.limb(j) >> bit_shift;
+    if (bit_shift != 0 and j + 1 < n) {
+      res |= a.limb(j + 1) << (LSIZE - bit_shift);
+    }
+    return res;
+  }
+  bool refers_to(const void *p) const { return a.refers_to(p); }
+  bool reads_shifted(const void *p) const { return a.refers_to(p); }
+};
+
+// bitmask whose least significant limb is low and whose other limbs are high,
+// shifted to the left, such as 1 << x, ~1 << x or ~0 << x. It reads no
+// big_int: each limb is made of the two limbs of the mask it straddles when it
+// is read, so a mask used in an expression is never built as a big_int. As in
+// a shift, shifting by a negative amount or by Bits or more bits gives zero
+template <int Bits>
+class big_int_shifted_mask
+    : public big_int_expr<Bits, big_int_shifted_mask<Bits> > {
+ private:
+  uint64_t low, high;         // the limbs of the mask before the shift
+  int limb_shift, bit_shift;  // the shift amount, as in big_int_shift
+
+  // returns the limb j of the mask before the shift, zero below the first
+  uint64_t mask_limb(int j) const { return j < 0 ? 0 : (j == 0 ? low : high); }
+
+ public:
+  static const bool sequential = false;
+
+  big_int_shifted_mask(uint64_t low_, uint64_t high_, int x)
+      : low(low_), high(high_) {
+    if (x < 0 or x >= Bits) x = basic_big_int<Bits>::limb_count * LSIZE;
+    limb_shift = x / LSIZE;
+    bit_shift = x % LSIZE;
+  }
+
+  uint64_t limb(int i) const {
+    int j = i - limb_shift;
+    uint64_t res = mask_limb(j) << bit_shift;
+    if (bit_shift != 0) res |= mask_limb(j - 1) >> (LSIZE - bit_shift);
+    return res & basic_big_int<Bits>::limb_mask(i);
+  }
+  bool refers_to(const void *p) const { return false; }
+  bool reads_shifted(const void *p) const { return false; }
+};
+
+// sum, or difference if Subtract is true, of two expressions. The carry of
+// each limb goes to the next one, so the limbs must be read in order, once
+template <int Bits, class A, class B, bool Subtract>
+class big_int_sum
+    : public big_int_expr<Bits, big_int_sum<Bits, A, B, Subtract> > {
+ private:
+  typename big_int_operand<Bits, A>::type a;
+  typename big_int_operand<Bits, B>::type b;
+  mutable unsigned char carry;  // carry, or borrow, into the next limb
+
+ public:
+  static const bool sequential = true;
+
+  big_int_sum(const A &a_, const B &b_) : a(a_), b(b_), carry(0) {}
+
+  uint64_t limb(int i) const {
+    uint64_t res;
+    if (Subtract) {
+      carry = sub_with_borrow(carry, a.limb(i), b.limb(i), &res);
+    } else {
+      carry = add_with_carry(carry, a.limb(i), b.limb(i), &res);
+    }
+    return res & basic_big_int<Bits>::limb_mask(i);
+  }
+  bool refers_to(const void *p) const {
+    return a.refers_to(p) or b.refers_to(p);
+  }
+  bool reads_shifted(const void *p) const {
+    return a.reads_shifted(p) or b.reads_shifted(p);
+  }
+};
+
+// operators on expressions, which include big_ints. They are not members of
+// basic_big_int, so that a big_int and any other expression can be mixed in
+// either order
+
+template <int Bits, class A, class B>
+big_int_bitwise<Bits, A, B, big_int_and> operator&(
+    const big_int_expr<Bits, A> &a, const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_logic);
+  return big_int_bitwise<Bits, A, B, big_int_and>(a.self(), b.self());
+}
+
+template <int Bits, class A, class B>
+big_int_bitwise<Bits, A, B, big_int_or> operator|(
+    const big_int_expr<Bits, A> &a, const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_logic);
+  return big_int_bitwise<Bits, A, B, big_int_or>(a.self(), b.self());
+}
+
+template <int Bits, class A, class B>
+big_int_bitwise<Bits, A, B, big_int_xor> operator^(
+    const big_int_expr<Bits, A> &a, const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_logic);
+  return big_int_bitwise<Bits, A, B, big_int_xor>(a.self(), b.self());
+}
+
+template <int Bits, class A>
+big_int_not<Bits, A> operator~(const big_int_expr<Bits, A> &a) {
+  COUNT_OP(op_logic);
+  return big_int_not<Bits, A>(a.self());
+}
+
+template <int Bits, class A>
+big_int_shift<Bits, A, true> operator<<(const big_int_expr<Bits, A> &a,
+                                        const int x) {
+  COUNT_OP(op_shift);
+  return big_int_shift<Bits, A, true>(a.self(), x);
+}
+
+template <int Bits, class A>
+big_int_shift<Bits, A, false> operator>>(const big_int_expr<Bits, A> &a,
+                                         const int x) {
+  COUNT_OP(op_shift);
+  return big_int_shift<Bits, A, false>(a.self(), x);
+}
+
+template <int Bits, class A, class B>
+big_int_sum<Bits, A, B, false> operator+(const big_int_expr<Bits, A> &a,
+                                         const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_add);
+  return big_int_sum<Bits, A, B, false>(a.self(), b.self());
+}
+
+template <int Bits, class A, class B>
+big_int_sum<Bits, A, B, true> operator-(const big_int_expr<Bits, A> &a,
+                                        const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_add);
+  return big_int_sum<Bits, A, B, true>(a.self(), b.self());
+}
+
+// the multiplication needs every limb of its operands many times, so they are
+// evaluated first. The product is computed in place, in the copy of a
+template <int Bits, class A, class B>
+basic_big_int<Bits> operator*(const big_int_expr<Bits, A> &a,
+                              const big_int_expr<Bits, B> &b) {
+  basic_big_int<Bits> res = a;
+  res *= b.self();
+  return res;
+}
+
+// compares two expressions from the most significant limb, stopping at the
+// first limb in which they differ, and returns -1, 0 or 1
+template <int Bits, class A, class B>
+int compare_expressions(const big_int_expr<Bits, A> &a,
+                        const big_int_expr<Bits, B> &b) {
+  COUNT_OP(op_compare);
+  typename big_int_random_access<Bits, A>::type x = a.self();
+  typename big_int_random_access<Bits, B>::type y = b.self();
+  for (int i = basic_big_int<Bits>::limb_count - 1; i >= 0; i--) {
+    uint64_t x_limb = x.limb(i), y_limb = y.limb(i);
+    if (x_limb != y_limb) return x_limb < y_limb ? -1 : 1;
+  }
+  return 0;
+}
+
+template <int Bits, class A, class B>
+bool operator<(const big_int_expr<Bits, A> &a, const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) < 0;
+}
+
+template <int Bits, class A, class B>
+bool operator<=(const big_int_expr<Bits, A> &a,
+                const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) <= 0;
+}
+
+template <int Bits, class A, class B>
+bool operator>(const big_int_expr<Bits, A> &a, const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) > 0;
+}
+
+template <int Bits, class A, class B>
+bool operator>=(const big_int_expr<Bits, A> &a,
+                const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) >= 0;
+}
+
+template <int Bits, class A, class B>
+bool operator==(const big_int_expr<Bits, A> &a,
+                const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) == 0;
+}
+
+template <int Bits, class A, class B>
+bool operator!=(const big_int_expr<Bits, A> &a,
+                const big_int_expr<Bits, B> &b) {
+  return compare_expressions(a, b) != 0;
+}
+
+// multiplies big_ints by a constant with few set bits, such as the masks used
+// by the fusion tree, doing one shifted addition for each set bit of the
+// constant
+class sparse_multiplier {
+ private:
+  std::vector<int> set_bits;  // positions of the set bits of the constant
+
+ public:
+  sparse_multiplier() {}
+
+  template <int Bits>
+  explicit sparse_multiplier(const basic_big_int<Bits> &c);
+
+  // returns x * c, truncated to the size of x
+  template <int Bits>
+  basic_big_int<Bits> multiply(const basic_big_int<Bits> &x) const;
+
+  // keeps x * c in res, which must not be x, without building a new big_int
+  template <int Bits>
+  void multiply(const basic_big_int<Bits> &x, basic_big_int<Bits> &res) const;
+
+  // returns the positions of the set bits of the constant, in increasing order
+  const std::vector<int> &positions() const { return set_bits; }
+
+  // keeps x * c in res for an expression x, which is evaluated first since
+  // its limbs are read once for each set bit of the constant
+  template <int Bits, class E>
+  void multiply(const big_int_expr<Bits, E> &x, basic_big_int<Bits> &res) const;
+};
+
+template <int Bits, class E>
+basic_big_int<Bits> operator*(const big_int_expr<Bits, E> &x,
+                              const sparse_multiplier &c);
+
+template <int Bits>
+basic_big_int<Bits> &operator*=(basic_big_int<Bits> &x,
+                                const sparse_multiplier &c);
+
+template <int Bits>
+std::ostream &operator<<(std::ostream &out, const basic_big_int<Bits> &bi);
+
+// clears the bits of the most significant limb that lie beyond Bits, so that
+// every operation behaves as if it was done modulo 2^Bits
+template <int Bits>
+void basic_big_int<Bits>::clear_padding() {
+  if (Bits % LSIZE != 0) {
+    limbs[limb_count - 1] &= (uint64_t(1) << (Bits % LSIZE)) - 1;
+  }
+}
+
+template <int Bits>
+int basic_big_int<Bits>::used_limbs() const {
+  int used = limb_count;
+  while (used > 0 and limbs[used - 1] == 0) used--;
+  return used;
+}
+
+// adds x << shift limb by limb. Only the limbs covered by x need a full
+// addition, after them the carry is propagated until it dies
+template <int Bits>
+void basic_big_int<Bits>::add_shifted(const basic_big_int &x, int shift) {
+  if (shift < 0 or shift >= Bits) return;
+
+  int limb_shift = shift / LSIZE, bit_shift = shift % LSIZE;
+  int used = x.used_limbs();
+  unsigned char carry = 0;
+  int i = limb_shift;
+
+  for (int j = 0; j <= used and i < limb_count; j++, i++) {
+    uint64_t shifted = (j < used ? x.limbs[j] << bit_shift : 0);
+    if (bit_shift != 0 and j > 0) {
+      shifted |= x.limbs[j - 1] >> (LSIZE - bit_shift);
+    }
+    carry = add_with_carry(carry, limbs[i], shifted, &limbs[i]);
+  }
+  for (; carry != 0 and i < limb_count; i++) {
+    carry = add_with_carry(carry, limbs[i], 0, &limbs[i]);
+  }
+
+  clear_padding();
+}
+
+template <int Bits>
+int basic_big_int<Bits>::word_size() const {
+  return Bits;
+}
+
+template <int Bits>
+int basic_big_int<Bits>::most_significant_bit() const {
+  COUNT_OP(op_logic);
+  for (int i = limb_count - 1; i >= 0; i--) {
+    if (limbs[i] != 0) {
+      return i * LSIZE + (LSIZE - 1 - __builtin_clzll(limbs[i]));
+    }
+  }
+  return -1;
+}
+
+template <int Bits>
+int basic_big_int<Bits>::first_diff(const basic_big_int &x) const {
+  COUNT_OP(op_logic);
+  for (int i = limb_count - 1; i >= 0; i--) {
+    if (limbs[i] != x.limbs[i]) {
+      return i * LSIZE + (LSIZE - 1 - __builtin_clzll(limbs[i] ^ x.limbs[i]));
+    }
+  }
+  return -1;
+}
+
+template <int Bits>
+int basic_big_int<Bits>::next_set_bit(int i) const {
+  COUNT_OP(op_logic);
+  if (i < 0) i = 0;
+  if (i >= Bits) return -1;
+  // the bits below i in its limb are ignored
+  int j = i / LSIZE;
+  uint64_t limb = limbs[j] & (~uint64_t(0) << (i % LSIZE));
+  while (limb == 0) {
+    if (++j == limb_count) return -1;
+    limb = limbs[j];
+  }
+  return j * LSIZE + __builtin_ctzll(limb);
+}
+
+template <int Bits>
+int basic_big_int<Bits>::next_clear_bit(int i) const {
+  COUNT_OP(op_logic);
+  if (i < 0) i = 0;
+  if (i >= Bits) return -1;
+  // the bits below i in its limb are taken as set
+  int j = i / LSIZE;
+  uint64_t limb = ~limbs[j] & (~uint64_t(0) << (i % LSIZE));
+  while (limb == 0) {
+    if (++j == limb_count) return -1;
+    limb = ~limbs[j];
+  }
+  int res = j * LSIZE + __builtin_ctzll(limb);
+  // the padding bits above Bits are clear, but they are not part of *this
+  return res < Bits ? res : -1;
+}
+
+template <int Bits>
+void basic_big_int<Bits>::set_bit(int i) {
+  COUNT_OP(op_logic);
+  limbs[i / LSIZE] |= uint64_t(1) << (i % LSIZE);
+}
+
+template <int Bits>
+uint64_t basic_big_int<Bits>::extract_bits(const basic_big_int &mask) const {
+  COUNT_OP(op_logic);
+#if defined(__x86_64__)
+  if (cpu_supports_bmi2()) {
+    return parallel_extract_limbs(limbs, mask.limbs, limb_count);
+  }
+#endif
+  // without pext, move the selected bits one by one
+  uint64_t res = 0;
+  int offset = 0;
+  for (int i = 0; i < limb_count; i++) {
+    for (uint64_t bits = mask.limbs[i]; bits != 0; bits &= bits - 1) {
+      res |= ((limbs[i] >> __builtin_ctzll(bits)) & 1) << offset;
+      offset++;
+    }
+  }
+  return res;
+}
+
+template <int Bits>
+basic_big_int<Bits>::operator int() const {
+  return int(limbs[0]);
+}
+
+template <int Bits>
+basic_big_int<Bits>::basic_big_int(int x) {
+  // as in a bitset, a negative int only fills the first limb
+  limbs[0] = uint64_t(int64_t(x));
+  for (int i = 1; i < limb_count; i++) {
+    limbs[i] = 0;
+  }
+  clear_padding();
+}
+
+template <int Bits>
+basic_big_int<Bits>::basic_big_int(const std::bitset<Bits> &b) {
+  for (int i = 0; i < limb_count; i++) {
+    limbs[i] = 0;
+  }
+  for (int i = 0; i < Bits; i++) {
+    if (b[i]) {
+      limbs[i / LSIZE] |= uint64_t(1) << (i % LSIZE);
+    }
+  }
+}
+
+template <int Bits>
+basic_big_int<Bits>::basic_big_int(const uint64_t *x, int n) {
+  for (int i = 0; i < limb_count; i++) {
+    limbs[i] = (i < n ? x[i] : 0);
+  }
+  clear_padding();
+}
+
+// whole limbs are loaded with load_limb, and only the bytes of a partial most
+// significant limb are read one by one. In big endian order the least
+// significant byte is the last one, so limb i ends 8 * i bytes before the end
+template <int Bits>
+basic_big_int<Bits>::basic_big_int(const uint8_t *bytes, size_t n,
+                                   byte_order order) {
+  size_t used = n < sizeof(limbs) ? n : sizeof(limbs);
+  int full = used / sizeof(uint64_t), rest = used % sizeof(uint64_t);
+  for (int i = 0; i < full; i++) {
+    limbs[i] = load_limb(order == little_endian_order
+                             ? bytes + i * sizeof(uint64_t)
+                             : bytes + n - (i + 1) * sizeof(uint64_t),
+                         order);
+  }
+  for (int i = full; i < limb_count; i++) {
+    limbs[i] = 0;
+  }
+  for (int j = 0; j < rest; j++) {
+    int k = full * sizeof(uint64_t) + j;  // index of the byte in the integer
+    uint64_t byte =
+        (order == little_endian_order ? bytes[k] : bytes[n - 1 - k]);
+    limbs[full] |= byte << (8 * j);
+  }
+  clear_padding();
+}
+
+// reads the digits from the last one, a limb of 16 digits at a time
+template <int Bits>
+basic_big_int<Bits> basic_big_int<Bits>::from_hex(const std::string &hex) {
+  size_t start = 0;
+  if (hex.size() >= 2 and hex[0] == '0' and (hex[1] == 'x' or hex[1] == 'X')) {
+    start = 2;
+  }
+  if (start == hex.size()) throw(std::string("empty hexadecimal number"));
+
+  basic_big_int res(0);
+  int digit = 0;  // index of the digit from the least significant one
+  for (size_t i = hex.size(); i > start; i--, digit++) {
+    char c = hex[i - 1];
+    uint64_t value;
+    if (c >= '0' and c <= '9') {
+      value = c - '0';
+    } else if (c >= 'a' and c <= 'f') {
+      value = c - 'a' + 10;
+    } else if (c >= 'A' and c <= 'F') {
+      value = c - 'A' + 10;
+    } else {
+      throw(std::string("invalid hexadecimal digit in ") + hex);
+    }
+    if (digit / 16 < limb_count) {
+      res.limbs[digit / 16] |= value << (4 * (digit % 16));
+    }
+  }
+  res.clear_padding();
+  return res;
+}
+
+template <int Bits>
+void basic_big_int<Bits>::to_limbs(uint64_t *x, int n) const {
+  for (int i = 0; i < n; i++) {
+    x[i] = (i < limb_count ? limbs[i] : 0);
+  }
+}
+
+// the reverse of the constructor from bytes
+template <int Bits>
+void basic_big_int<Bits>::to_bytes(uint8_t *bytes, size_t n,
+                                   byte_order order) const {
+  size_t used = n < sizeof(limbs) ? n : sizeof(limbs);
+  int full = used / sizeof(uint64_t);
+  for (int i = 0; i < full; i++) {
+    store_limb(limbs[i],
+               order == little_endian_order
+                   ? bytes + i * sizeof(uint64_t)
+                   : bytes + n - (i + 1) * sizeof(uint64_t),
+               order);
+  }
+  for (size_t k = full * sizeof(uint64_t); k < n; k++) {
+    uint8_t byte = 0;
+    if (k < used) byte = uint8_t(limbs[full] >> (8 * (k % sizeof(uint64_t))));
+    bytes[order == little_endian_order ? k : n - 1 - k] = byte;
+  }
+}
+
+// writes 16 digits for each limb below the most significant non-zero one
+template <int Bits>
+std::string basic_big_int<Bits>::to_hex() const {
+  static const char digits[] = "0123456789abcdef";
+  int used = used_limbs();
+  if (used == 0) return "0";
+
+  std::string res;
+  uint64_t top = limbs[used - 1];
+  for (int shift = (LSIZE - 1 - __builtin_clzll(top)) / 4 * 4; shift >= 0;
+       shift -= 4) {
+    res += digits[(top >> shift) & 15];
+  }
+  for (int i = used - 2; i >= 0; i--) {
+    for (int shift = LSIZE - 4; shift >= 0; shift -= 4) {
+      res += digits[(limbs[i] >> shift) & 15];
+    }
+  }
+  return res;
+}
+
+// a basic_big_int is only its array of limbs, since its base class is empty,
+// so an array of them has the layout of the limbs one after the other
+template <int Bits>
+const basic_big_int<Bits> *basic_big_int<Bits>::view(const uint64_t *x,
+                                                     size_t count) {
+  static_assert(sizeof(basic_big_int) == limb_count * sizeof(uint64_t),
+                "basic_big_int is not only its limbs");
+  if ((uintptr_t)x % alignof(basic_big_int) != 0) {
+    throw(std::string("the limbs of a big_int view are not aligned"));
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint64_t top = x[(i + 1) * limb_count - 1];
+    if ((top & ~limb_mask(limb_count - 1)) != 0) {
+      throw(std::string("a big_int view has bits set above its size"));
+    }
+  }
+  return reinterpret_cast<const basic_big_int *>(x);
+}
+
+// evaluates the expression limb by limb, from the least significant one
+template <int Bits>
+template <class E>
+basic_big_int<Bits>::basic_big_int(const big_int_expr<Bits, E> &e) {
+  const E &x = e.self();
+  for (int i = 0; i < limb_count; i++) {
+    limbs[i] = x.limb(i);
+  }
+}
+
+// an expression that only reads limb i of *this to compute limb i can be
+// written over *this, since each limb is read before it is written
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator=(
+    const big_int_expr<Bits, E> &e) {
+  const E &x = e.self();
+  if (x.reads_shifted(this)) return *this = basic_big_int(e);
+  for (int i = 0; i < limb_count; i++) {
+    limbs[i] = x.limb(i);
+  }
+  return *this;
+}
+
+template <int Bits>
+uint64_t basic_big_int<Bits>::limb_mask(int i) {
+  if (Bits % LSIZE != 0 and i == limb_count - 1) {
+    return (uint64_t(1) << (Bits % LSIZE)) - 1;
+  }
+  return ~uint64_t(0);
+}
+
+template <int Bits>
+basic_big_int<Bits> basic_big_int<Bits>::operator-() const {
+  return (basic_big_int(0) - (*this));
+}
+
+// shifts move whole limbs first and then the remaining bits inside the limbs.
+// Shifting by a negative amount or by Bits or more bits gives zero, as it does
+// in a bitset. The left shift writes the limbs from the most significant one,
+// so that each limb is read before it is overwritten
+template <int Bits>
+basic_big_int<Bits> &basic_big_int<Bits>::operator<<=(const int x) {
+  COUNT_OP(op_shift);
+  if (x < 0 or x >= Bits) return *this = basic_big_int(0);
+
+  int limb_shift = x / LSIZE, bit_shift = x % LSIZE;
+  for (int i = limb_count - 1; i >= limb_shift; i--) {
+    limbs[i] = limbs[i - limb_shift] << bit_shift;
+    if (bit_shift != 0 and i - limb_shift - 1 >= 0) {
+      limbs[i] |= limbs[i - limb_shift - 1] >> (LSIZE - bit_shift);
+    }
+  }
+  for (int i = 0; i < limb_shift; i++) {
+    limbs[i] = 0;
+  }
+  clear_padding();
+  return *this;
+}
+
+// the right shift writes the limbs from the least significant one
+template <int Bits>
+basic_big_int<Bits> &basic_big_int<Bits>::operator>>=(const int x) {
+  COUNT_OP(op_shift);
+  if (x < 0 or x >= Bits) return *this = basic_big_int(0);
+
+  int limb_shift = x / LSIZE, bit_shift = x % LSIZE;
+  for (int i = 0; i + limb_shift < limb_count; i++) {
+    limbs[i] = limbs[i + limb_shift] >> bit_shift;
+    if (bit_shift != 0 and i + limb_shift + 1 < limb_count) {
+      limbs[i] |= limbs[i + limb_shift + 1] << (LSIZE - bit_shift);
+    }
+  }
+  for (int i = limb_count - limb_shift; i < limb_count; i++) {
+    limbs[i] = 0;
+  }
+  return *this;
+}
+
+// the in place bitwise operators, addition and subtraction assign the
+// expression of *this and x to *this, reading x in the same pass
+
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator|=(
+    const big_int_expr<Bits, E> &x) {
+  COUNT_OP(op_logic);
+  return *this = big_int_bitwise<Bits, basic_big_int, E, big_int_or>(
+             *this, x.self());
+}
+
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator&=(
+    const big_int_expr<Bits, E> &x) {
+  COUNT_OP(op_logic);
+  return *this = big_int_bitwise<Bits, basic_big_int, E, big_int_and>(
+             *this, x.self());
+}
 
-  big_int(const std::bitset<WSIZE> &b);
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator^=(
+    const big_int_expr<Bits, E> &x) {
+  COUNT_OP(op_logic);
+  return *this = big_int_bitwise<Bits, basic_big_int, E, big_int_xor>(
+             *this, x.self());
+}
 
-  big_int operator~() const;
+// adds x limb by limb, propagating the carry through the whole chain
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator+=(
+    const big_int_expr<Bits, E> &x) {
+  COUNT_OP(op_add);
+  return *this = big_int_sum<Bits, basic_big_int, E, false>(*this, x.self());
+}
 
-  big_int operator-() const;
+// subtracts x limb by limb, propagating the borrow through the whole chain
+template <int Bits>
+template <class E>
+basic_big_int<Bits> &basic_big_int<Bits>::operator-=(
+    const big_int_expr<Bits, E> &x) {
+  COUNT_OP(op_add);
+  return *this = big_int_sum<Bits, basic_big_int, E, true>(*this, x.self());
+}
 
-  bool operator<(const big_int x) const;
+// schoolbook multiplication over the limbs, in place. Only the lower
+// limb_count limbs of the product are computed, and the limbs above the most
+// significant non-zero limb of each operand are skipped. The limbs of *this
+// are taken from the most significant one, and the product of limb i with x
+// only touches limbs i and above, which were already taken, so no copy of
+// *this is needed
+template <int Bits>
+basic_big_int<Bits> &basic_big_int<Bits>::operator*=(const basic_big_int &x) {
+  // squaring reads x while *this changes, so it needs a copy
+  if (&x == this) {
+    basic_big_int y = x;
+    return *this *= y;
+  }
+  COUNT_OP(op_mul);
 
-  bool operator<=(const big_int x) const;
+  int used = used_limbs(), x_used = x.used_limbs();
 
-  bool operator>(const big_int x) const;
+  for (int i = used - 1; i >= 0; i--) {
+    uint64_t limb = limbs[i];
+    limbs[i] = 0;
+    if (limb == 0) continue;
 
-  bool operator>=(const big_int x) const;
+    uint64_t carry = 0;
+    int j = 0;
+    for (; j < x_used and i + j < limb_count; j++) {
+      unsigned __int128 prod =
+          (unsigned __int128)limb * x.limbs[j] + limbs[i + j] + carry;
+      limbs[i + j] = uint64_t(prod);
+      carry = uint64_t(prod >> LSIZE);
+    }
+    // the limbs above already hold the products of the higher limbs, so the
+    // carry is added to them until it dies
+    for (int k = i + j; carry != 0 and k < limb_count; k++) {
+      carry = add_with_carry(0, limbs[k], carry, &limbs[k]);
+    }
+  }
 
-  bool operator==(const big_int x) const;
+  clear_padding();
+  return *this;
+}
 
-  bool operator!=(const big_int x) const;
+// keeps the positions of the set bits of c
+template <int Bits>
+sparse_multiplier::sparse_multiplier(const basic_big_int<Bits> &c) {
+  for (int i = 0; i < basic_big_int<Bits>::limb_count; i++) {
+    for (uint64_t bits = c.limbs[i]; bits != 0; bits &= bits - 1) {
+      set_bits.push_back(i * LSIZE + __builtin_ctzll(bits));
+    }
+  }
+}
 
-  big_int operator<<(const int x) const;
+// adds one shifted copy of x for each set bit of the constant
+template <int Bits>
+basic_big_int<Bits> sparse_multiplier::multiply(
+    const basic_big_int<Bits> &x) const {
+  basic_big_int<Bits> res;
+  multiply(x, res);
+  return res;
+}
 
-  big_int operator>>(const int x) const;
+template <int Bits>
+void sparse_multiplier::multiply(const basic_big_int<Bits> &x,
+                                 basic_big_int<Bits> &res) const {
+  COUNT_OP(op_mul);
+  res = basic_big_int<Bits>(0);
+  for (int i = 0; i < (int)set_bits.size(); i++) {
+    res.add_shifted(x, set_bits[i]);
+  }
+}
 
-  big_int operator|(const big_int x) const;
+template <int Bits, class E>
+void sparse_multiplier::multiply(const big_int_expr<Bits, E> &x,
+                                 basic_big_int<Bits> &res) const {
+  multiply(basic_big_int<Bits>(x), res);
+}
 
-  big_int operator&(const big_int x) const;
+template <int Bits, class E>
+basic_big_int<Bits> operator*(const big_int_expr<Bits, E> &x,
+                              const sparse_multiplier &c) {
+  basic_big_int<Bits> res;
+  c.multiply(x.self(), res);
+  return res;
+}
 
-  big_int operator^(const big_int x) const;
+// the shifted copies are added to x itself, so only the original value of x
+// is kept aside
+template <int Bits>
+basic_big_int<Bits> &operator*=(basic_big_int<Bits> &x,
+                                const sparse_multiplier &c) {
+  basic_big_int<Bits> original = x;
+  c.multiply(original, x);
+  return x;
+}
 
-  big_int operator+(const big_int x) const;
+// reads each bit from its limb, and writes the whole line at once
+template <int Bits>
+std::ostream &operator<<(std::ostream &out, const basic_big_int<Bits> &bi) {
+  int printed = PSIZE < Bits ? PSIZE : Bits;
+  const uint64_t *limbs = bi.data();
+  std::string line;
+  line.reserve(printed + printed / PINTERV);
+  for (int i = printed - 1; i >= 0; i--) {
+    line += char('0' + ((limbs[i / LSIZE] >> (i % LSIZE)) & 1));
+    if ((printed - 1 - i) % PINTERV == PINTERV - 1) {
+      line += ' ';
+    }
+  }
 
-  big_int operator-(const big_int x) const;
+  return out << line;
+}
 
-  big_int operator*(const big_int x) const;
+// hash of a big_int, so that it can be the key of an unordered_map. Each limb
+// is mixed into the hash with a multiplication and a shift
+namespace std {
+template <int Bits>
+struct hash<basic_big_int<Bits> > {
+  size_t operator()(const basic_big_int<Bits> &x) const {
+    const uint64_t *limbs = x.data();
+    uint64_t res = 0;
+    for (int i = 0; i < basic_big_int<Bits>::limb_count; i++) {
+      res = (res ^ limbs[i]) * 0x9e3779b97f4a7c15ULL;
+      res ^= res >> 29;
+    }
+    return res;
+  }
 };
+}  // namespace std
 
-std::ostream &operator<<(std::ostream &out, const big_int &bi);
+// the default big_int is compiled once, in big_int.cpp
+extern template class basic_big_int<WSIZE>;
 
 #endif /* big_int_hpp */
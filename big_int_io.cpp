@@ -0,0 +1,15 @@
+//
+//  big_int_io.cpp
+//  Fusion Tree
+//
+
+#include "big_int_io.hpp"
+
+// compiles the helpers over the default big_int, so that programs using them
+// do not need to instantiate them again
+template vector<big_int> read_big_ints<WSIZE>(const char *, size_t,
+                                              byte_order);
+template void write_big_ints<WSIZE>(const char *, const vector<big_int> &,
+                                    size_t, byte_order);
+template const big_int *map_big_ints<WSIZE>(const mapped_file &, size_t &);
+template vector<big_int> read_hex_big_ints<WSIZE>(const char *);
@@ -0,0 +1,163 @@
+//
+//  big_int_io.hpp
+//  Fusion Tree
+//
+
+#ifndef big_int_io_hpp
+#define big_int_io_hpp
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_file.hpp"
+
+using namespace std;
+
+// loading and writing many keys at once. A key file keeps the keys one after
+// the other, each in key_bytes bytes in the given byte order, without any
+// header. The keys are read in blocks, and each one is built limb by limb
+// with the constructor of basic_big_int from bytes
+
+// returns the keys of a key file. Throws a string if the file cannot be read
+// or its size is not a multiple of key_bytes
+template <int Bits>
+vector<basic_big_int<Bits> > read_big_ints(const char *path, size_t key_bytes,
+                                           byte_order order);
+
+// writes keys to a key file, keeping the key_bytes least significant bytes of
+// each of them. Throws a string if the file cannot be written
+template <int Bits>
+void write_big_ints(const char *path, const vector<basic_big_int<Bits> > &keys,
+                    size_t key_bytes, byte_order order);
+
+// returns the keys of a key file mapped into memory, read in place without
+// copying them, and keeps their number in count. The keys must be kept as
+// whole limbs, in the byte order of the machine, that is, written by
+// write_big_ints with key_bytes = limb_count * 8 and the order of the machine.
+// The file must outlive the keys. Throws a string if the size of the file is
+// not a multiple of the size of a key
+template <int Bits>
+const basic_big_int<Bits> *map_big_ints(const mapped_file &file,
+                                        size_t &count);
+
+// returns the keys of a text file with one key in hexadecimal in each line,
+// skipping the empty lines. Throws a string if the file cannot be read or a
+// line is not a hexadecimal number
+template <int Bits>
+vector<basic_big_int<Bits> > read_hex_big_ints(const char *path);
+
+// number of bytes read or written at a time
+#define KEY_BLOCK_SIZE (1 << 20)
+
+// reads whole keys in blocks, so that a key never straddles two blocks
+
+template <int Bits>
+vector<basic_big_int<Bits> > read_big_ints(const char *path, size_t key_bytes,
+                                           byte_order order) {
+  if (key_bytes == 0) throw(string("keys must have at least one byte"));
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) throw(string("cannot open ") + path);
+
+  vector<basic_big_int<Bits> > keys;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if (size > 0) keys.reserve(size / key_bytes);
+    fseek(file, 0, SEEK_SET);
+  }
+
+  size_t keys_per_block = KEY_BLOCK_SIZE / key_bytes + 1;
+  vector<uint8_t> block(keys_per_block * key_bytes);
+  size_t read;
+  while ((read = fread(block.data(), 1, block.size(), file)) > 0) {
+    if (read % key_bytes != 0) {
+      fclose(file);
+      throw(string("the size of ") + path + " is not a multiple of the keys");
+    }
+    for (size_t i = 0; i < read; i += key_bytes) {
+      keys.push_back(basic_big_int<Bits>(block.data() + i, key_bytes, order));
+    }
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) throw(string("cannot read ") + path);
+  return keys;
+}
+
+template <int Bits>
+void write_big_ints(const char *path, const vector<basic_big_int<Bits> > &keys,
+                    size_t key_bytes, byte_order order) {
+  if (key_bytes == 0) throw(string("keys must have at least one byte"));
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) throw(string("cannot open ") + path + " for writing");
+
+  size_t keys_per_block = KEY_BLOCK_SIZE / key_bytes + 1;
+  vector<uint8_t> block(keys_per_block * key_bytes);
+  bool failed = false;
+  for (size_t first = 0; first < keys.size() and !failed;
+       first += keys_per_block) {
+    size_t n = min(keys_per_block, keys.size() - first);
+    for (size_t i = 0; i < n; i++) {
+      keys[first + i].to_bytes(block.data() + i * key_bytes, key_bytes, order);
+    }
+    failed = fwrite(block.data(), key_bytes, n, file) != n;
+  }
+  if (fclose(file) != 0 or failed) throw(string("cannot write ") + path);
+}
+
+template <int Bits>
+const basic_big_int<Bits> *map_big_ints(const mapped_file &file,
+                                        size_t &count) {
+  size_t key_size = sizeof(basic_big_int<Bits>);
+  if (file.size() % key_size != 0) {
+    throw(string("the size of the file is not a multiple of the keys"));
+  }
+  count = file.size() / key_size;
+  return basic_big_int<Bits>::view((const uint64_t *)file.data(), count);
+}
+
+template <int Bits>
+vector<basic_big_int<Bits> > read_hex_big_ints(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) throw(string("cannot open ") + path);
+
+  vector<basic_big_int<Bits> > keys;
+  string line;
+  char buffer[4096];
+  try {
+    // a line longer than the buffer is read in several pieces
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+      line += buffer;
+      if (line.back() != '\n' and !feof(file)) continue;
+      while (!line.empty() and isspace((unsigned char)line.back())) {
+        line.pop_back();
+      }
+      if (!line.empty()) keys.push_back(basic_big_int<Bits>::from_hex(line));
+      line.clear();
+    }
+  } catch (...) {
+    fclose(file);
+    throw;
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) throw(string("cannot read ") + path);
+  return keys;
+}
+
+// the helpers over the default big_int are compiled once, in big_int_io.cpp
+extern template vector<big_int> read_big_ints<WSIZE>(const char *, size_t,
+                                                     byte_order);
+extern template void write_big_ints<WSIZE>(const char *,
+                                           const vector<big_int> &, size_t,
+                                           byte_order);
+extern template const big_int *map_big_ints<WSIZE>(const mapped_file &,
+                                                   size_t &);
+extern template vector<big_int> read_hex_big_ints<WSIZE>(const char *);
+
+#endif /* big_int_io_hpp */
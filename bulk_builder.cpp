@@ -0,0 +1,10 @@
+//
+//  bulk_builder.cpp
+//  Fusion Tree
+//
+
+#include "bulk_builder.hpp"
+
+// compiles the builder over the default big_int, so that programs using it do
+// not need to instantiate it again
+template class basic_bulk_builder<big_int>;
@@ -0,0 +1,128 @@
+//
+//  bulk_builder.hpp
+//  Fusion Tree
+//
+
+#ifndef bulk_builder_hpp
+#define bulk_builder_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusiontree.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+// pool of threads that build many fusion tree nodes at once, over the same
+// environment. Building a node finds its important bits, m and the parallel
+// comparison word, which is much slower than querying it, and the nodes are
+// independent, so each thread of a thread_pool takes the next node to build
+// from an atomic counter until none is left. Each thread copies the elements
+// of its nodes into its own scratch vector, which keeps its memory from one
+// node to the next, so the threads do not allocate for the elements nor share
+// any buffer. The nodes are allocated with new, like the nodes of
+// basic_fusion_btree, which builds its levels with a bulk builder when one is
+// given
+template <class word, class env_type = basic_environment<word> >
+class basic_bulk_builder {
+ public:
+  // fusion tree built for each node
+  typedef basic_fusiontree<word, env_type> fusiontree_type;
+
+ private:
+  const env_type *my_env;  // environment of the nodes. It is only read
+  thread_pool workers;     // threads that build the nodes
+  vector<vector<word> > scratch;  // elements of the node each thread builds
+
+  // a pool owns its threads, so it cannot be copied
+  basic_bulk_builder(const basic_bulk_builder &);
+  basic_bulk_builder &operator=(const basic_bulk_builder &);
+
+ public:
+  // number of threads in the pool
+  const int size() const;
+
+  // builds n_ nodes. Node i keeps the sorted, distinct elements
+  // elements_[bounds_[i]] to elements_[bounds_[i + 1] - 1], at most capacity of
+  // them, and out_[i] is set to it. The nodes belong to the caller, who frees
+  // them with delete. Blocks until all the nodes are built
+  void build(const word *elements_, const int *bounds_, int n_,
+             fusiontree_type **out_);
+
+  // splits the sorted, distinct elements in v_ evenly among as few nodes as
+  // possible and builds them, in increasing order
+  vector<fusiontree_type *> build(const vector<word> &v_);
+
+  // pool constructor
+  // starts threads_ threads that build nodes over the environment my_env_, or
+  // one per hardware thread if threads_ is 0. The environment must outlive the
+  // pool and the nodes
+  basic_bulk_builder(const env_type *my_env_, int threads_ = 0);
+};
+
+// the builder of nodes over the default big_int
+typedef basic_bulk_builder<big_int> bulk_builder;
+
+// returns the number of threads in the pool
+
+template <class word, class env_type>
+const int basic_bulk_builder<word, env_type>::size() const {
+  return workers.size();
+}
+
+// builds n_ nodes with all the threads of the pool. The job lives in this
+// call, which blocks until every thread is done with it
+
+template <class word, class env_type>
+void basic_bulk_builder<word, env_type>::build(const word *elements_,
+                                               const int *bounds_, int n_,
+                                               fusiontree_type **out_) {
+  if (n_ <= 0) return;
+
+  atomic<int> next_node(0);  // next node to be built
+  workers.run([&](int worker) {
+    vector<word> &elements = scratch[worker];
+    while (true) {
+      int i = next_node.fetch_add(1);
+      if (i >= n_) break;
+      elements.assign(elements_ + bounds_[i], elements_ + bounds_[i + 1]);
+      out_[i] = new fusiontree_type(elements, my_env);
+    }
+  });
+}
+
+// splits the elements evenly among the nodes, the first ones taking one extra
+// element, as basic_fusion_btree splits its leaves
+
+template <class word, class env_type>
+vector<typename basic_bulk_builder<word, env_type>::fusiontree_type *>
+basic_bulk_builder<word, env_type>::build(const vector<word> &v_) {
+  int count = v_.size();
+  int capacity = my_env->capacity;
+  int nodes = (count + capacity - 1) / capacity;
+
+  vector<int> node_bounds(nodes + 1, 0);
+  for (int i = 0; i < nodes; i++) {
+    node_bounds[i + 1] =
+        node_bounds[i] + count / nodes + (i < count % nodes ? 1 : 0);
+  }
+
+  vector<fusiontree_type *> res(nodes, NULL);
+  build(v_.data(), node_bounds.data(), nodes, res.data());
+  return res;
+}
+
+// pool constructor
+
+template <class word, class env_type>
+basic_bulk_builder<word, env_type>::basic_bulk_builder(const env_type *my_env_,
+                                                       int threads_)
+    : my_env(my_env_), workers(threads_), scratch(workers.size()) {}
+
+// the builder over the default big_int is compiled once, in bulk_builder.cpp
+extern template class basic_bulk_builder<big_int>;
+
+#endif /* bulk_builder_hpp */
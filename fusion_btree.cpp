@@ -0,0 +1,10 @@
+//
+//  fusion_btree.cpp
+//  Fusion Tree
+//
+
+#include "fusion_btree.hpp"
+
+// compiles the B-tree over the default big_int, so that programs using it do
+// not need to instantiate it again
+template class basic_fusion_btree<big_int>;
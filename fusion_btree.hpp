@@ -0,0 +1,956 @@
+//
+//  fusion_btree.hpp
+//  Fusion Tree
+//
+
+#ifndef fusion_btree_hpp
+#define fusion_btree_hpp
+
+#include <limits.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "big_int.hpp"
+#include "bulk_builder.hpp"
+#include "fusiontree.hpp"
+
+using namespace std;
+
+// B-tree with a fusion tree in each node. The leaves keep the elements, at
+// most capacity of them each, and each internal node keeps the smallest element
+// of each of its at most capacity children. A predecessor query descends one
+// level at a time with a constant time query in the fusion tree of each node,
+// so it takes O(log n / log capacity) node queries. Insertions and removals
+// update the fusion trees in place, and split or merge the nodes that go above
+// capacity or below half of it. Like in the fusion tree, the const methods
+// can run in many threads at once, while insert and erase need the B-tree for
+// themselves
+template <class word, class env_type = basic_environment<word> >
+class basic_fusion_btree {
+ private:
+  // fusion tree in the nodes, over the same environment
+  typedef basic_fusiontree<word, env_type> fusiontree_type;
+
+  // pool of threads that builds the fusion trees of a level at once
+  typedef basic_bulk_builder<word, env_type> builder_type;
+
+  // node of the B-tree
+  struct node {
+    fusiontree_type *keys;    // fusion tree with the elements of a leaf
+                              // or the smallest elements of the children
+                              // of an internal node
+    vector<node *> children;  // children of the node, empty in a leaf
+    int count;                // number of elements in the subtree
+  };
+
+  const env_type *my_env;  // object with the specifications of the fusion
+                           // trees in the nodes. It is only read
+  shared_ptr<const env_type> env_owner;  // keeps my_env alive when the B-tree
+                                         // shares its ownership, empty
+                                         // otherwise
+
+  node *root;  // root of the B-tree, or NULL if it is empty
+  int height;  // number of levels of the B-tree
+
+  // builds the fusion trees of nodes_count nodes, node i over keys[bounds[i]]
+  // to keys[bounds[i + 1] - 1], with the threads of builder, or in this thread
+  // if builder is NULL
+  vector<fusiontree_type *> build_fusiontrees(vector<word> &keys,
+                                              const vector<int> &bounds,
+                                              builder_type *builder);
+
+  // builds the leaves over the sorted elements, spreading them evenly so that
+  // every leaf has at least half of the capacity when possible
+  vector<node *> build_leaves(vector<word> &elements_, builder_type *builder);
+
+  // builds the level above the given nodes and returns its nodes
+  vector<node *> build_level(vector<node *> &level, builder_type *builder);
+
+  // sorts the elements, removes the repeated ones and builds the B-tree bottom
+  // up over them
+  void bulk_load(vector<word> &elements_, builder_type *builder);
+
+  // frees a subtree
+  void destroy(node *n);
+
+  // checks that the nodes of a B-tree read from a file, in breadth-first
+  // order from the root, have their leaves in the last of height levels, and
+  // keep the given number of elements, the smallest element of each child
+  // and the counts of their subtrees. Throws a string otherwise
+  void check_structure(const vector<node *> &nodes, uint64_t size_);
+
+  // returns the elements of a leaf, or the children of an internal node, in
+  // increasing order
+  vector<word> node_elements(node *n);
+
+  // builds the fusion tree of node n over the smallest elements of its
+  // children, and recalculates its count
+  void rebuild_internal(node *n);
+
+  // inserts x in the subtree of node n. If n goes above capacity, it is split
+  // and the new node with its larger half is returned. Otherwise returns NULL
+  node *insert(node *n, const word &x, bool &inserted);
+
+  // returns the number of elements in the subtree of node n smaller than x
+  const int rank(const node *n, const word &x) const;
+
+  // removes x from the subtree of node n. Returns whether x was found
+  bool erase(node *n, const word &x);
+
+  // fixes child idx of node n, which went below half of the capacity, merging
+  // it with a sibling or moving elements from the sibling
+  void rebalance(node *n, int idx);
+
+  // a B-tree owns its nodes, so it cannot be copied
+  basic_fusion_btree(const basic_fusion_btree &);
+  basic_fusion_btree &operator=(const basic_fusion_btree &);
+
+ public:
+  // returns the number of elements stored
+  const int size() const;
+
+  // returns the number of levels of the B-tree
+  const int levels() const;
+
+  // returns the element of rank i, i.e., in position i in increasing order
+  const word pos(int i) const;
+
+  // returns the rank of the biggest k in the B-tree such that k<=x
+  // or -1 if there is no such k
+  const int find_predecessor(const word &x) const;
+
+  // finds the rank of the predecessor of each of the n integers in queries, as
+  // find_predecessor, and keeps them in out. All the queries descend one level
+  // before any of them descends the next one
+  void find_predecessor_batch(const word *queries, int n, int *out) const;
+
+  // returns the rank of the smallest k in the B-tree such that k>=x
+  // or -1 if there is no such k
+  const int find_successor(const word &x) const;
+
+  // returns the number of elements in the B-tree smaller than x
+  const int rank(const word &x) const;
+
+  // returns the number of elements k in the B-tree such that a<=k<b. The
+  // paths of a and b are descended once down to the node where they part
+  const int count_range(const word &a, const word &b) const;
+
+  // inserts x in the B-tree. Returns false if x is already stored
+  bool insert(const word &x);
+
+  // removes x from the B-tree. Returns false if x is not stored
+  bool erase(const word &x);
+
+  // writes the B-tree to a file in path, with the node record of each of its
+  // nodes, as described in fusion_file.hpp. Throws a string if the file cannot
+  // be written
+  void save(const char *path) const;
+
+  // B-tree constructor. Bulk loads the elements of v_, which do not need to be
+  // sorted. Repeated elements are stored once. The environment must outlive
+  // the B-tree. Throws a string if its capacity is below 2
+  basic_fusion_btree(vector<word> &v_, const env_type *my_env_);
+
+  // B-tree constructor that shares the ownership of the environment, so that
+  // it lives while any B-tree over it does
+  basic_fusion_btree(vector<word> &v_, shared_ptr<const env_type> my_env_);
+
+  // B-tree constructor that builds the fusion trees of each level with the
+  // threads of builder_, which must be over the same environment
+  basic_fusion_btree(vector<word> &v_, const env_type *my_env_,
+                     builder_type &builder_);
+
+  // B-tree constructor over a file written by save, mapped into memory. The
+  // nodes are not built again, and read their elements in place, so the file
+  // must outlive the B-tree. It must have been written over an environment
+  // with the same parameters as my_env_. Throws a string otherwise
+  basic_fusion_btree(const mapped_file &file_, const env_type *my_env_);
+
+  // B-tree destructor
+  ~basic_fusion_btree();
+};
+
+// the B-tree over the default big_int
+typedef basic_fusion_btree<big_int> fusion_btree;
+
+// builds the fusion trees of the nodes of a level over the given keys
+
+template <class word, class env_type>
+vector<typename basic_fusion_btree<word, env_type>::fusiontree_type *>
+basic_fusion_btree<word, env_type>::build_fusiontrees(vector<word> &keys,
+                                                      const vector<int> &bounds,
+                                                      builder_type *builder) {
+  int nodes_count = bounds.size() - 1;
+  vector<fusiontree_type *> res(nodes_count, NULL);
+  if (builder != NULL) {
+    builder->build(keys.data(), bounds.data(), nodes_count, res.data());
+    return res;
+  }
+  for (int i = 0; i < nodes_count; i++) {
+    vector<word> node_keys(keys.begin() + bounds[i],
+                           keys.begin() + bounds[i + 1]);
+    res[i] = new fusiontree_type(node_keys, my_env);
+  }
+  return res;
+}
+
+// builds the leaves over the sorted elements
+
+template <class word, class env_type>
+vector<typename basic_fusion_btree<word, env_type>::node *>
+basic_fusion_btree<word, env_type>::build_leaves(vector<word> &elements_,
+                                                 builder_type *builder) {
+  int n = elements_.size();
+  int capacity = my_env->capacity;
+  // number of leaves needed to keep all the elements
+  int leaves_count = (n + capacity - 1) / capacity;
+
+  // the first n % leaves_count leaves take one extra element
+  vector<int> bounds(leaves_count + 1, 0);
+  for (int i = 0; i < leaves_count; i++) {
+    bounds[i + 1] =
+        bounds[i] + n / leaves_count + (i < n % leaves_count ? 1 : 0);
+  }
+  vector<fusiontree_type *> keys =
+      build_fusiontrees(elements_, bounds, builder);
+
+  vector<node *> leaves;
+  for (int i = 0; i < leaves_count; i++) {
+    node *leaf = new node;
+    leaf->keys = keys[i];
+    leaf->count = bounds[i + 1] - bounds[i];
+    leaves.push_back(leaf);
+  }
+  return leaves;
+}
+
+// builds the level above the given nodes, grouping at most capacity
+// consecutive nodes under each new node
+
+template <class word, class env_type>
+vector<typename basic_fusion_btree<word, env_type>::node *>
+basic_fusion_btree<word, env_type>::build_level(vector<node *> &level,
+                                                builder_type *builder) {
+  int n = level.size();
+  int capacity = my_env->capacity;
+  int parents_count = (n + capacity - 1) / capacity;
+
+  vector<int> bounds(parents_count + 1, 0);
+  for (int i = 0; i < parents_count; i++) {
+    bounds[i + 1] =
+        bounds[i] + n / parents_count + (i < n % parents_count ? 1 : 0);
+  }
+  // the key of each child is its smallest element, which is the first
+  // element of its first leaf
+  vector<word> level_keys;
+  for (int j = 0; j < n; j++) {
+    level_keys.push_back(level[j]->keys->pos(0));
+  }
+  vector<fusiontree_type *> keys =
+      build_fusiontrees(level_keys, bounds, builder);
+
+  vector<node *> parents;
+  for (int i = 0; i < parents_count; i++) {
+    node *parent = new node;
+    parent->keys = keys[i];
+    parent->count = 0;
+    for (int j = bounds[i]; j < bounds[i + 1]; j++) {
+      parent->children.push_back(level[j]);
+      parent->count += level[j]->count;
+    }
+    parents.push_back(parent);
+  }
+  return parents;
+}
+
+// frees a subtree
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::destroy(node *n) {
+  for (int i = 0; i < (int)n->children.size(); i++) {
+    destroy(n->children[i]);
+  }
+  delete n->keys;
+  delete n;
+}
+
+// returns the elements of a leaf, or the children of an internal node, in
+// increasing order
+
+template <class word, class env_type>
+vector<word> basic_fusion_btree<word, env_type>::node_elements(node *n) {
+  vector<word> res;
+  for (int i = 0; i < n->keys->size(); i++) {
+    res.push_back(n->keys->pos(i));
+  }
+  return res;
+}
+
+// builds the fusion tree of an internal node over the smallest elements of its
+// children, which are the first elements of their fusion trees
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::rebuild_internal(node *n) {
+  vector<word> keys;
+  n->count = 0;
+  for (int i = 0; i < (int)n->children.size(); i++) {
+    keys.push_back(n->children[i]->keys->pos(0));
+    n->count += n->children[i]->count;
+  }
+  delete n->keys;
+  n->keys = new fusiontree_type(keys, my_env);
+}
+
+// inserts x in the subtree of node n and splits n if it goes above capacity
+
+template <class word, class env_type>
+typename basic_fusion_btree<word, env_type>::node *
+basic_fusion_btree<word, env_type>::insert(node *n, const word &x,
+                                           bool &inserted) {
+  int capacity = my_env->capacity;
+
+  if (n->children.empty()) {
+    // x is already in the leaf
+    int idx = n->keys->find_predecessor(x);
+    if (idx >= 0 and n->keys->pos(idx) == x) {
+      inserted = false;
+      return NULL;
+    }
+    inserted = true;
+    n->count++;
+
+    // if there is room in the leaf, update its fusion tree in place
+    if (n->keys->insert(x)) return NULL;
+
+    // otherwise, split the elements of the leaf and x in two halves
+    vector<word> elements_ = node_elements(n);
+    elements_.insert(elements_.begin() + idx + 1, x);
+    int half = (capacity + 1) / 2;
+    vector<word> left(elements_.begin(), elements_.begin() + half);
+    vector<word> right(elements_.begin() + half, elements_.end());
+
+    delete n->keys;
+    n->keys = new fusiontree_type(left, my_env);
+    n->count = left.size();
+
+    node *sibling = new node;
+    sibling->keys = new fusiontree_type(right, my_env);
+    sibling->count = right.size();
+    return sibling;
+  }
+
+  // the child whose subtree must contain x. If x is smaller than every
+  // element, it goes to the first child
+  int idx = max(n->keys->find_predecessor(x), 0);
+  node *child = n->children[idx];
+  word child_min = n->keys->pos(idx);
+
+  node *sibling = insert(child, x, inserted);
+  if (!inserted) return NULL;
+  n->count++;
+
+  // x is the new smallest element of the child
+  if (x < child_min) {
+    n->keys->erase(child_min);
+    n->keys->insert(x);
+  }
+
+  if (sibling == NULL) return NULL;
+
+  // the child was split, so its new sibling becomes child idx + 1
+  n->children.insert(n->children.begin() + idx + 1, sibling);
+  if (n->keys->insert(sibling->keys->pos(0))) return NULL;
+
+  // n has too many children now, so split them in two halves
+  node *n_sibling = new node;
+  n_sibling->keys = NULL;
+  n_sibling->children.assign(n->children.begin() + (capacity + 1) / 2,
+                             n->children.end());
+  n->children.resize((capacity + 1) / 2);
+  rebuild_internal(n);
+  rebuild_internal(n_sibling);
+  return n_sibling;
+}
+
+// removes x from the subtree of node n, fixing the children that go below
+// half of the capacity
+
+template <class word, class env_type>
+bool basic_fusion_btree<word, env_type>::erase(node *n, const word &x) {
+  int idx = n->keys->find_predecessor(x);
+  if (idx < 0) return false;
+
+  if (n->children.empty()) {
+    if (n->keys->pos(idx) != x) return false;
+    n->keys->erase(x);
+    n->count--;
+    return true;
+  }
+
+  node *child = n->children[idx];
+  if (!erase(child, x)) return false;
+  n->count--;
+
+  // at capacity 2 a node other than the root may keep a single element or a
+  // single child, which has no sibling to merge with in its parent. When it
+  // is left empty, it is removed with its key, and if n is left empty too,
+  // its own parent removes it in the same way
+  if (child->count == 0) {
+    n->keys->erase(n->keys->pos(idx));
+    n->children.erase(n->children.begin() + idx);
+    destroy(child);
+    return true;
+  }
+
+  // x was the smallest element of the child, so its key changes
+  if (n->keys->pos(idx) == x) {
+    n->keys->erase(x);
+    n->keys->insert(child->keys->pos(0));
+  }
+
+  if (child->keys->size() < (my_env->capacity + 1) / 2) {
+    rebalance(n, idx);
+  }
+  return true;
+}
+
+// fixes child idx of node n, which went below half of the capacity
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::rebalance(node *n, int idx) {
+  // a single child cannot be fixed. Above capacity 2 it only happens at the
+  // root, which is replaced by its child in erase, and at capacity 2 a child
+  // only goes below half of the capacity when it is empty, and erase removes
+  // it before
+  if (n->children.size() == 1) return;
+
+  // fix the pair formed by the child and its right sibling, or its left
+  // sibling if it is the last child
+  if (idx == (int)n->children.size() - 1) idx--;
+  node *left = n->children[idx];
+  node *right = n->children[idx + 1];
+  word left_key = n->keys->pos(idx);
+  word right_key = n->keys->pos(idx + 1);
+
+  if (left->children.empty()) {
+    vector<word> elements_ = node_elements(left);
+    vector<word> right_elements = node_elements(right);
+    elements_.insert(elements_.end(), right_elements.begin(),
+                     right_elements.end());
+    int total = elements_.size();
+
+    // if both leaves fit in one, merge them in the left one
+    if (total <= my_env->capacity) {
+      delete left->keys;
+      left->keys = new fusiontree_type(elements_, my_env);
+      left->count = total;
+      destroy(right);
+      n->children.erase(n->children.begin() + idx + 1);
+      n->keys->erase(left_key);
+      n->keys->erase(right_key);
+      n->keys->insert(left->keys->pos(0));
+      return;
+    }
+
+    // otherwise, split the elements evenly between them
+    vector<word> left_elements(elements_.begin(),
+                               elements_.begin() + total / 2);
+    right_elements.assign(elements_.begin() + total / 2, elements_.end());
+    delete left->keys;
+    delete right->keys;
+    left->keys = new fusiontree_type(left_elements, my_env);
+    right->keys = new fusiontree_type(right_elements, my_env);
+    left->count = left_elements.size();
+    right->count = right_elements.size();
+  } else {
+    vector<node *> children = left->children;
+    children.insert(children.end(), right->children.begin(),
+                    right->children.end());
+    int total = children.size();
+
+    // if both nodes fit in one, merge them in the left one
+    if (total <= my_env->capacity) {
+      left->children = children;
+      rebuild_internal(left);
+      right->children.clear();
+      destroy(right);
+      n->children.erase(n->children.begin() + idx + 1);
+      n->keys->erase(left_key);
+      n->keys->erase(right_key);
+      n->keys->insert(left->keys->pos(0));
+      return;
+    }
+
+    // otherwise, split the children evenly between them
+    left->children.assign(children.begin(), children.begin() + total / 2);
+    right->children.assign(children.begin() + total / 2, children.end());
+    rebuild_internal(left);
+    rebuild_internal(right);
+  }
+
+  // the smallest elements of both nodes may have changed
+  n->keys->erase(left_key);
+  n->keys->erase(right_key);
+  n->keys->insert(left->keys->pos(0));
+  n->keys->insert(right->keys->pos(0));
+}
+
+// returns the number of elements stored
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::size() const {
+  return root == NULL ? 0 : root->count;
+}
+
+// returns the number of levels of the B-tree
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::levels() const {
+  return height;
+}
+
+// returns the element of rank i, descending through the counts of the
+// subtrees
+
+template <class word, class env_type>
+const word basic_fusion_btree<word, env_type>::pos(int i) const {
+  node *cur = root;
+  while (!cur->children.empty()) {
+    int j = 0;
+    while (i >= cur->children[j]->count) {
+      i -= cur->children[j]->count;
+      j++;
+    }
+    cur = cur->children[j];
+  }
+  return cur->keys->pos(i);
+}
+
+// returns the rank of the biggest k in the B-tree such that k<=x
+// or -1 if there is no such k
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::find_predecessor(
+    const word &x) const {
+  if (root == NULL) return -1;
+
+  int rank = 0;
+  node *cur = root;
+  while (!cur->children.empty()) {
+    // the predecessor of x among the smallest elements of the children is the
+    // child whose subtree contains the predecessor of x
+    int idx = cur->keys->find_predecessor(x);
+    // x is smaller than every element in the B-tree. It can only happen at
+    // the root, since a child is only visited if x is not smaller than its
+    // smallest element
+    if (idx < 0) return -1;
+
+    // every element in the children to the left is smaller than x
+    for (int j = 0; j < idx; j++) {
+      rank += cur->children[j]->count;
+    }
+    cur = cur->children[idx];
+  }
+
+  int idx = cur->keys->find_predecessor(x);
+  if (idx < 0) return -1;
+  return rank + idx;
+}
+
+// finds the rank of the predecessor of each of the n integers in queries. The
+// queries descend the B-tree together, one level at a time, so that the node
+// queries of the same level, which do not depend on each other, can overlap
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::find_predecessor_batch(
+    const word *queries, int n, int *out) const {
+  // node of the current level in the path of each query, or NULL if the query
+  // is already answered
+  vector<node *> cur(n, root);
+  for (int i = 0; i < n; i++) out[i] = root == NULL ? -1 : 0;
+
+  for (int level = 1; level <= height; level++) {
+    for (int i = 0; i < n; i++) {
+      if (cur[i] == NULL) continue;
+      int idx = cur[i]->keys->find_predecessor(queries[i]);
+
+      // x is smaller than every element in the B-tree
+      if (idx < 0) {
+        out[i] = -1;
+        cur[i] = NULL;
+      } else if (level == height) {
+        out[i] += idx;
+      } else {
+        // every element in the children to the left is smaller than x
+        for (int j = 0; j < idx; j++) {
+          out[i] += cur[i]->children[j]->count;
+        }
+        cur[i] = cur[i]->children[idx];
+      }
+    }
+  }
+}
+
+// returns the rank of the smallest k in the B-tree such that k>=x
+// or -1 if there is no such k
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::find_successor(
+    const word &x) const {
+  int answer = rank(x);
+  return answer < size() ? answer : -1;
+}
+
+// returns the number of elements in the B-tree smaller than x
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::rank(const word &x) const {
+  if (root == NULL) return 0;
+  return rank(root, x);
+}
+
+// returns the number of elements in the subtree of node n smaller than x. It
+// descends as find_predecessor, and asks the rank of x in the leaf
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::rank(const node *n,
+                                                   const word &x) const {
+  int answer = 0;
+  const node *cur = n;
+  while (!cur->children.empty()) {
+    int idx = cur->keys->find_predecessor(x);
+    // x is smaller than every element in the subtree
+    if (idx < 0) return answer;
+
+    for (int j = 0; j < idx; j++) {
+      answer += cur->children[j]->count;
+    }
+    cur = cur->children[idx];
+  }
+  return answer + cur->keys->rank(x);
+}
+
+// returns the number of elements k in the B-tree such that a<=k<b. While a and
+// b go down to the same child, the elements outside of it are outside of the
+// interval. Where they part, the interval holds the children between them,
+// without the elements smaller than a in the child of a, and with the elements
+// smaller than b in the child of b
+
+template <class word, class env_type>
+const int basic_fusion_btree<word, env_type>::count_range(const word &a,
+                                                          const word &b) const {
+  if (root == NULL or !(a < b)) return 0;
+
+  const node *cur = root;
+  while (!cur->children.empty()) {
+    int idx_a = cur->keys->find_predecessor(a);
+    int idx_b = cur->keys->find_predecessor(b);
+    // b is smaller than every element in the subtree
+    if (idx_b < 0) return 0;
+
+    if (idx_a < idx_b) {
+      int answer = 0;
+      if (idx_a >= 0) answer -= rank(cur->children[idx_a], a);
+      for (int j = max(idx_a, 0); j < idx_b; j++) {
+        answer += cur->children[j]->count;
+      }
+      return answer + rank(cur->children[idx_b], b);
+    }
+    cur = cur->children[idx_b];
+  }
+  return cur->keys->count_range(a, b);
+}
+
+// inserts x in the B-tree. If the root is split, a new root is created above
+// it and its new sibling
+
+template <class word, class env_type>
+bool basic_fusion_btree<word, env_type>::insert(const word &x) {
+  if (root == NULL) {
+    vector<word> elements_(1, x);
+    root = new node;
+    root->keys = new fusiontree_type(elements_, my_env);
+    root->count = 1;
+    height = 1;
+    return true;
+  }
+
+  bool inserted;
+  node *sibling = insert(root, x, inserted);
+  if (sibling != NULL) {
+    node *new_root = new node;
+    new_root->keys = NULL;
+    new_root->children.push_back(root);
+    new_root->children.push_back(sibling);
+    rebuild_internal(new_root);
+    root = new_root;
+    height++;
+  }
+  return inserted;
+}
+
+// removes x from the B-tree. While the root is left with a single child, the
+// child becomes the root
+
+template <class word, class env_type>
+bool basic_fusion_btree<word, env_type>::erase(const word &x) {
+  if (root == NULL or !erase(root, x)) return false;
+
+  if (root->count == 0) {
+    destroy(root);
+    root = NULL;
+    height = 0;
+  }
+  while (root != NULL and root->children.size() == 1) {
+    node *old_root = root;
+    root = root->children[0];
+    old_root->children.clear();
+    destroy(old_root);
+    height--;
+  }
+  return true;
+}
+
+// sorts the elements and builds the B-tree over them
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::bulk_load(vector<word> &elements_,
+                                                   builder_type *builder) {
+  root = NULL;
+  height = 0;
+
+  // with a single element in each node, every level would have as many nodes
+  // as the one below it
+  if (my_env->capacity < 2) {
+    throw(string("a B-tree needs a capacity of at least 2"));
+  }
+
+  // the fusion trees need distinct elements, and the B-tree needs them in
+  // increasing order to split them among the leaves
+  vector<word> sorted_elements = elements_;
+  std::sort(sorted_elements.begin(), sorted_elements.end());
+  sorted_elements.erase(
+      std::unique(sorted_elements.begin(), sorted_elements.end()),
+      sorted_elements.end());
+
+  if (sorted_elements.empty()) return;
+
+  // builds the B-tree bottom up, one level at a time, until a single node is
+  // left, which is the root
+  vector<node *> level = build_leaves(sorted_elements, builder);
+  height = 1;
+  while (level.size() > 1) {
+    level = build_level(level, builder);
+    height++;
+  }
+  root = level[0];
+}
+
+// B-tree constructor
+// v_ is a vector with the integers to be stored
+// my_env is the environment with the specifications of the fusion trees
+
+template <class word, class env_type>
+basic_fusion_btree<word, env_type>::basic_fusion_btree(
+    vector<word> &elements_, const env_type *my_env_) {
+  my_env = my_env_;
+  bulk_load(elements_, NULL);
+}
+
+// B-tree constructor that builds each level with the threads of a bulk
+// builder
+
+template <class word, class env_type>
+basic_fusion_btree<word, env_type>::basic_fusion_btree(
+    vector<word> &elements_, const env_type *my_env_, builder_type &builder_) {
+  my_env = my_env_;
+  bulk_load(elements_, &builder_);
+}
+
+// B-tree constructor that shares the ownership of the environment
+// the nodes keep only the raw pointer, since the B-tree outlives them
+
+template <class word, class env_type>
+basic_fusion_btree<word, env_type>::basic_fusion_btree(
+    vector<word> &elements_, shared_ptr<const env_type> my_env_)
+    : basic_fusion_btree(elements_, my_env_.get()) {
+  env_owner = my_env_;
+}
+
+// writes the B-tree to a file
+// the nodes are listed in breadth-first order, so the children of each node
+// are consecutive, and their records follow the list
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::save(const char *path) const {
+  vector<node *> nodes;
+  if (root != NULL) nodes.push_back(root);
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    for (int j = 0; j < (int)nodes[i]->children.size(); j++) {
+      nodes.push_back(nodes[i]->children[j]);
+    }
+  }
+
+  size_t file_size = sizeof(fusion_file_header) + sizeof(fusion_btree_header) +
+                     nodes.size() * sizeof(fusion_btree_entry);
+  vector<size_t> offsets;
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    offsets.push_back(file_size);
+    file_size += nodes[i]->keys->serialized_size();
+  }
+
+  vector<uint64_t> image(file_size / sizeof(uint64_t));
+  char *out = (char *)image.data();
+  *(fusion_file_header *)out =
+      make_fusion_file_header(fusion_file_btree, word::bits,
+                              my_env->element_size, my_env->capacity,
+                              file_size);
+  out += sizeof(fusion_file_header);
+
+  fusion_btree_header *header = (fusion_btree_header *)out;
+  header->size = size();
+  header->height = height;
+  header->node_count = nodes.size();
+  header->reserved = 0;
+  out += sizeof(fusion_btree_header);
+
+  fusion_btree_entry *entries = (fusion_btree_entry *)out;
+  int next_child = 1;
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    entries[i].record_offset = offsets[i];
+    entries[i].count = nodes[i]->count;
+    entries[i].first_child = next_child;
+    entries[i].child_count = nodes[i]->children.size();
+    next_child += nodes[i]->children.size();
+
+    nodes[i]->keys->serialize((char *)image.data() + offsets[i]);
+  }
+
+  write_fusion_file(path, image);
+}
+
+// B-tree constructor over a mapped file
+// checks the nodes read from a file, listed in breadth-first order
+
+template <class word, class env_type>
+void basic_fusion_btree<word, env_type>::check_structure(
+    const vector<node *> &nodes, uint64_t size_) {
+  // the depth of each node, which is one more than the one of its parent. The
+  // children of a node come after it, so its depth is known before theirs
+  vector<int> depth(nodes.size(), 0);
+  int next_child = 1;
+  bool consistent = root->count >= 0 and (uint64_t)root->count == size_;
+  for (int i = 0; i < (int)nodes.size() and consistent; i++) {
+    node *n = nodes[i];
+    int children_count = n->children.size();
+    if (children_count == 0) {
+      // the leaves are all in the last level, and keep their count
+      consistent = depth[i] == height - 1 and n->keys->size() == n->count and
+                   n->count > 0;
+      continue;
+    }
+    // an internal node keeps the smallest element of each of its children,
+    // and the sum of their counts
+    long long count = 0;
+    consistent = n->keys->size() == children_count;
+    for (int j = 0; j < children_count and consistent; j++) {
+      node *child = n->children[j];
+      depth[next_child + j] = depth[i] + 1;
+      count += child->count;
+      consistent = child->keys->size() > 0 and
+                   child->keys->pos(0) == n->keys->pos(j);
+    }
+    consistent = consistent and count == n->count;
+    next_child += children_count;
+  }
+  if (!consistent) throw(string("corrupt fusion tree file"));
+}
+
+// makes a node for each entry, with a fusion tree over its record, and links
+// each node with its consecutive children
+
+template <class word, class env_type>
+basic_fusion_btree<word, env_type>::basic_fusion_btree(
+    const mapped_file &file_, const env_type *my_env_) {
+  my_env = my_env_;
+  root = NULL;
+  height = 0;
+
+  const char *contents = file_.contents(fusion_file_btree, word::bits,
+                                        my_env->element_size, my_env->capacity);
+  size_t offset = contents - file_.data();
+  file_.check_range(offset, sizeof(fusion_btree_header));
+  const fusion_btree_header *header = (const fusion_btree_header *)contents;
+  offset += sizeof(fusion_btree_header);
+  // the number of entries is bounded by the file before it is multiplied, so
+  // that the size of the entries cannot wrap around
+  if (header->node_count >
+          (file_.size() - offset) / sizeof(fusion_btree_entry) or
+      header->node_count > (uint64_t)INT_MAX) {
+    throw(string("corrupt fusion tree file"));
+  }
+  int node_count = header->node_count;
+  file_.check_range(offset, node_count * sizeof(fusion_btree_entry));
+  const fusion_btree_entry *entries =
+      (const fusion_btree_entry *)(file_.data() + offset);
+
+  // the entries must list the nodes in breadth-first order, so the children
+  // of the nodes follow the root in the order of their parents, and every
+  // node but the root is listed after its parent
+  uint64_t next_child = 1;
+  for (int i = 0; i < node_count; i++) {
+    if (next_child <= (uint64_t)i or entries[i].first_child != next_child or
+        entries[i].child_count > (uint64_t)node_count - next_child) {
+      throw(string("corrupt fusion tree file"));
+    }
+    next_child += entries[i].child_count;
+  }
+  if (node_count == 0) {
+    if (header->size != 0 or header->height != 0) {
+      throw(string("corrupt fusion tree file"));
+    }
+    return;
+  }
+
+  vector<node *> nodes(node_count);
+  for (int i = 0; i < node_count; i++) {
+    nodes[i] = new node;
+    nodes[i]->keys = NULL;
+    nodes[i]->count = entries[i].count;
+  }
+  for (int i = 0; i < node_count; i++) {
+    for (int j = 0; j < (int)entries[i].child_count; j++) {
+      nodes[i]->children.push_back(nodes[entries[i].first_child + j]);
+    }
+  }
+  root = nodes[0];
+  height = header->height;
+
+  // every node is in the subtree of the root, so they are all freed with it if
+  // a record is corrupt
+  try {
+    for (int i = 0; i < node_count; i++) {
+      nodes[i]->keys = new fusiontree_type(
+          file_.node_record(entries[i].record_offset), my_env);
+    }
+    check_structure(nodes, header->size);
+  } catch (...) {
+    destroy(root);
+    throw;
+  }
+}
+
+// B-tree destructor
+
+template <class word, class env_type>
+basic_fusion_btree<word, env_type>::~basic_fusion_btree() {
+  if (root != NULL) destroy(root);
+}
+
+// the B-tree over the default big_int is compiled once, in fusion_btree.cpp
+extern template class basic_fusion_btree<big_int>;
+
+#endif /* fusion_btree_hpp */
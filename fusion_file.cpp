@@ -0,0 +1,120 @@
+//
+//  fusion_file.cpp
+//  Fusion Tree
+//
+
+#include "fusion_file.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// returns a file header for the given contents
+
+fusion_file_header make_fusion_file_header(fusion_file_kind kind,
+                                           int word_bits, int element_size,
+                                           int capacity, size_t file_size) {
+  fusion_file_header header;
+  header.magic = FUSION_FILE_MAGIC;
+  header.version = FUSION_FILE_VERSION;
+  header.kind = kind;
+  header.word_bits = word_bits;
+  header.element_size = element_size;
+  header.capacity = capacity;
+  header.file_size = file_size;
+  header.reserved = 0;
+  return header;
+}
+
+// writes the bytes of a file
+
+void write_fusion_file(const char *path, const vector<uint64_t> &image) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    throw(string("cannot open ") + path + " for writing");
+  }
+  size_t written = fwrite(image.data(), sizeof(uint64_t), image.size(), file);
+  if (fclose(file) != 0 or written != image.size()) {
+    throw(string("cannot write ") + path);
+  }
+}
+
+// maps the file in path
+
+mapped_file::mapped_file(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) throw(string("cannot open ") + path);
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 or info.st_size == 0) {
+    close(fd);
+    throw(string("cannot map the empty file ") + path);
+  }
+  length = info.st_size;
+
+  // the mapping keeps the file open, so the descriptor is not needed after it
+  void *mapping = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) throw(string("cannot map ") + path);
+  bytes = (const char *)mapping;
+}
+
+// unmaps the file
+
+mapped_file::~mapped_file() { munmap((void *)bytes, length); }
+
+// returns the beginning of the mapped file
+
+const char *mapped_file::data() const { return bytes; }
+
+// returns the number of bytes of the file
+
+size_t mapped_file::size() const { return length; }
+
+// checks the file header and returns what comes after it
+
+const char *mapped_file::contents(fusion_file_kind kind, int word_bits,
+                                  int element_size, int capacity) const {
+  check_range(0, sizeof(fusion_file_header));
+  const fusion_file_header *header = (const fusion_file_header *)bytes;
+
+  if (header->magic != FUSION_FILE_MAGIC) {
+    throw(string("not a fusion tree file"));
+  }
+  if (header->version != FUSION_FILE_VERSION) {
+    throw(string("unsupported fusion tree file version"));
+  }
+  if (header->kind != (uint64_t)kind) {
+    throw(string("the file keeps another kind of tree"));
+  }
+  if (header->word_bits != (uint64_t)word_bits or
+      header->element_size != (uint64_t)element_size or
+      header->capacity != (uint64_t)capacity) {
+    throw(string("the file was written over another environment"));
+  }
+  if (header->file_size != length) {
+    throw(string("the file is truncated"));
+  }
+  return bytes + sizeof(fusion_file_header);
+}
+
+// checks that a range of bytes is in the file
+
+void mapped_file::check_range(size_t offset, size_t count) const {
+  if (offset % sizeof(uint64_t) != 0 or offset > length or
+      count > length - offset) {
+    throw(string("corrupt fusion tree file"));
+  }
+}
+
+// returns a node record of the file
+
+const char *mapped_file::node_record(size_t offset) const {
+  check_range(offset, sizeof(fusion_node_header));
+  const fusion_node_header *header =
+      (const fusion_node_header *)(bytes + offset);
+  check_range(offset, header->record_size);
+  return bytes + offset;
+}
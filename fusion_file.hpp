@@ -0,0 +1,142 @@
+//
+//  fusion_file.hpp
+//  Fusion Tree
+//
+
+#ifndef fusion_file_hpp
+#define fusion_file_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// binary format of the files written by the save methods of basic_fusiontree
+// and basic_fusion_btree. A file keeps the nodes already built, with their
+// masks and sketches, so that a process can map it into memory and query it
+// without building the nodes again. Every field is a 64-bit integer, or a
+// word of the fusion tree, which is made of 64-bit limbs, in the byte order of
+// the machine that wrote the file, and every record starts at a multiple of 8
+// bytes from the beginning of the file, so the words can be read in place from
+// the mapped file. A file is made of:
+//
+//   fusion_file_header, which says what the file keeps and over which
+//   environment the nodes were built.
+//
+//   for a single fusion tree, the node record;
+//
+//   for a B-tree, a fusion_btree_header, then one fusion_btree_entry for each
+//   node, in breadth-first order from the root, so that the children of a node
+//   have consecutive indices, and then the node records, at the offsets kept
+//   in the entries.
+//
+// A node record is a fusion_node_header, followed by the words data,
+// extract_interposed_bits, sketch_mask, mask_important_bits and m, the
+// important_bits_count indices of the important bits, the m_count indices of
+// the set bits of m, the lane_count lanes with the sketches of the elements,
+// and the size elements, in increasing order. The integer that repeats a
+// sketch in the parallel comparison is not kept, since it only depends on
+// sketch_size and the capacity
+
+// first 8 bytes of a file, "FUSIONTR" in the order they are written
+#define FUSION_FILE_MAGIC 0x52544e4f49535546ULL
+
+// version of the format. Files of other versions are not read
+#define FUSION_FILE_VERSION 1
+
+// what a file keeps
+enum fusion_file_kind { fusion_file_node = 1, fusion_file_btree = 2 };
+
+// beginning of every file
+struct fusion_file_header {
+  uint64_t magic;         // FUSION_FILE_MAGIC
+  uint64_t version;       // FUSION_FILE_VERSION
+  uint64_t kind;          // fusion_file_kind
+  uint64_t word_bits;     // size of the word type, in bits
+  uint64_t element_size;  // parameters of the environment of the nodes
+  uint64_t capacity;
+  uint64_t file_size;  // number of bytes in the file, including the header
+  uint64_t reserved;   // zero
+};
+
+// beginning of a node record
+struct fusion_node_header {
+  uint64_t record_size;  // number of bytes in the record, including the header
+  uint64_t size;         // number of elements
+  uint64_t important_bits_count;
+  uint64_t m_count;  // number of set bits of m, zero for exact sketches
+  uint64_t sketch_size;
+  uint64_t sketch_shift;
+  uint64_t exact_sketches;  // 1 if the sketches are gathered with pext
+  uint64_t lane_count;      // number of lanes, zero if they are not used
+};
+
+// B-tree after the file header
+struct fusion_btree_header {
+  uint64_t size;        // number of elements
+  uint64_t height;      // number of levels
+  uint64_t node_count;  // number of entries after this header
+  uint64_t reserved;    // zero
+};
+
+// node of a B-tree
+struct fusion_btree_entry {
+  uint64_t record_offset;  // offset of the node record from the beginning of
+                           // the file
+  uint64_t count;          // number of elements in the subtree of the node
+  uint64_t first_child;    // index of the entry of the first child
+  uint64_t child_count;    // number of children, zero in a leaf
+};
+
+// returns a file header for the given contents
+fusion_file_header make_fusion_file_header(fusion_file_kind kind,
+                                           int word_bits, int element_size,
+                                           int capacity, size_t file_size);
+
+// writes the bytes of a file, kept in 64-bit integers so that they are
+// aligned. Throws a string if the file cannot be written
+void write_fusion_file(const char *path, const vector<uint64_t> &image);
+
+// file mapped into memory, read-only, with mmap. The trees read from it keep
+// pointers to its contents, so it must outlive them
+class mapped_file {
+ private:
+  const char *bytes;  // beginning of the mapping
+  size_t length;      // number of bytes mapped
+
+  // a mapping is unmapped once, so it cannot be copied
+  mapped_file(const mapped_file &);
+  mapped_file &operator=(const mapped_file &);
+
+ public:
+  // maps the file in path. Throws a string if it cannot be opened
+  explicit mapped_file(const char *path);
+
+  // unmaps the file
+  ~mapped_file();
+
+  // returns the beginning of the mapped file
+  const char *data() const;
+
+  // returns the number of bytes of the file
+  size_t size() const;
+
+  // checks that the file keeps the given kind of tree, with the current
+  // version, over an environment with the given parameters, and returns its
+  // contents after the file header. Throws a string otherwise
+  const char *contents(fusion_file_kind kind, int word_bits, int element_size,
+                       int capacity) const;
+
+  // throws a string if the offset-th to (offset + count - 1)-th bytes of the
+  // file are not all in it, or offset is not a multiple of 8
+  void check_range(size_t offset, size_t count) const;
+
+  // returns the node record that starts offset bytes after the beginning of
+  // the file, after checking that the whole record is in the file
+  const char *node_record(size_t offset) const;
+};
+
+#endif /* fusion_file_hpp */
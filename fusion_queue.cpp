@@ -0,0 +1,10 @@
+//
+//  fusion_queue.cpp
+//  Fusion Tree
+//
+
+#include "fusion_queue.hpp"
+
+// compiles the queue over the default big_int, so that programs using it do
+// not need to instantiate it again
+template class basic_fusion_queue<big_int>;
@@ -0,0 +1,246 @@
+//
+//  fusion_queue.hpp
+//  Fusion Tree
+//
+
+#ifndef fusion_queue_hpp
+#define fusion_queue_hpp
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+
+using namespace std;
+
+// priority queue of integer priorities, kept in a fusion B-tree. The tree
+// keeps each distinct priority once, and the entries with the same priority
+// are kept in a bucket of that priority, found with a hash of it. Pushing a
+// new priority or removing the last entry of one inserts it in the tree or
+// erases it, with O(log n / log capacity) fusion tree node operations, and the
+// smallest priority is kept aside, so that peek_min takes constant time. Each
+// entry gets a handle when it is pushed, which decrease_key takes to find it.
+// The handles of the removed entries are given again to later entries. Every
+// priority must fit in the element_size bits of the environment, which push
+// checks
+template <class word, class env_type = basic_environment<word> >
+class basic_fusion_queue {
+ private:
+  typedef basic_fusion_btree<word, env_type> btree_type;
+
+  // entry of the queue
+  struct entry {
+    word priority;
+    int position;  // position of the entry in the bucket of its priority, or
+                   // -1 if the handle is free
+  };
+
+  const env_type *my_env;  // object with the specifications of the fusion
+                           // trees in the B-tree. It is only read
+  btree_type *tree;        // distinct priorities of the entries
+  unordered_map<word, vector<int> > buckets;  // handles of the entries of each
+                                              // priority in the tree
+  vector<entry> entries;  // entries, indexed by their handles
+  vector<int> free_handles;  // handles of the removed entries
+  word min_priority;         // smallest priority in the tree, if not empty
+  int sz;                    // number of entries
+
+  // adds handle to the bucket of priority, and priority to the tree if it is
+  // not there yet
+  void add_to_bucket(int handle, const word &priority);
+
+  // removes handle from the bucket of its priority, and the priority from
+  // the tree if no other entry has it
+  void remove_from_bucket(int handle);
+
+  // throws a string if handle is not the handle of an entry of the queue
+  void check_handle(int handle) const;
+
+  // a queue owns its tree, so it cannot be copied
+  basic_fusion_queue(const basic_fusion_queue &);
+  basic_fusion_queue &operator=(const basic_fusion_queue &);
+
+ public:
+  // returns the number of entries
+  const int size() const;
+
+  // returns true if the queue has no entries
+  const bool empty() const;
+
+  // adds an entry with the given priority and returns its handle. Throws a
+  // string if the priority has a bit set above the element size
+  int push(const word &priority);
+
+  // returns the smallest priority. Throws a string if the queue is empty
+  const word &peek_min() const;
+
+  // returns the handle of an entry with the smallest priority. Throws a
+  // string if the queue is empty
+  const int min_handle() const;
+
+  // removes an entry with the smallest priority and returns its handle.
+  // Throws a string if the queue is empty
+  int pop_min();
+
+  // returns the priority of the entry of handle
+  const word &priority(int handle) const;
+
+  // changes the priority of the entry of handle to a priority not greater
+  // than the current one. Throws a string if the handle is not in the queue
+  // or the priority is greater
+  void decrease_key(int handle, const word &priority);
+
+  // queue constructor. The queue starts empty, and the environment must
+  // outlive it
+  basic_fusion_queue(const env_type *my_env_);
+
+  // queue destructor
+  ~basic_fusion_queue();
+};
+
+// the queue over the default big_int
+typedef basic_fusion_queue<big_int> fusion_queue;
+
+// adds a handle to the bucket of a priority
+
+template <class word, class env_type>
+void basic_fusion_queue<word, env_type>::add_to_bucket(int handle,
+                                                       const word &priority) {
+  vector<int> &bucket = buckets[priority];
+  if (bucket.empty()) {
+    tree->insert(priority);
+    if (sz == 0 or priority < min_priority) min_priority = priority;
+  }
+  entries[handle].priority = priority;
+  entries[handle].position = bucket.size();
+  bucket.push_back(handle);
+  sz++;
+}
+
+// removes a handle from the bucket of its priority
+// the last handle of the bucket takes its position, so the bucket has no gaps
+
+template <class word, class env_type>
+void basic_fusion_queue<word, env_type>::remove_from_bucket(int handle) {
+  entry &e = entries[handle];
+  typename unordered_map<word, vector<int> >::iterator it =
+      buckets.find(e.priority);
+  vector<int> &bucket = it->second;
+  int last = bucket.back();
+  bucket[e.position] = last;
+  entries[last].position = e.position;
+  bucket.pop_back();
+  e.position = -1;
+  sz--;
+
+  if (bucket.empty()) {
+    tree->erase(e.priority);
+    buckets.erase(it);
+    if (sz > 0 and e.priority == min_priority) min_priority = tree->pos(0);
+  }
+}
+
+template <class word, class env_type>
+void basic_fusion_queue<word, env_type>::check_handle(int handle) const {
+  if (handle < 0 or handle >= (int)entries.size() or
+      entries[handle].position < 0) {
+    throw(string("the handle is not in the queue"));
+  }
+}
+
+template <class word, class env_type>
+const int basic_fusion_queue<word, env_type>::size() const {
+  return sz;
+}
+
+template <class word, class env_type>
+const bool basic_fusion_queue<word, env_type>::empty() const {
+  return sz == 0;
+}
+
+// adds an entry, with a free handle if there is one
+
+template <class word, class env_type>
+int basic_fusion_queue<word, env_type>::push(const word &priority) {
+  if (priority.next_set_bit(my_env->element_size) != -1) {
+    throw(string("the priority is too large for the environment"));
+  }
+  int handle;
+  if (!free_handles.empty()) {
+    handle = free_handles.back();
+    free_handles.pop_back();
+  } else {
+    handle = entries.size();
+    entries.push_back(entry());
+  }
+  add_to_bucket(handle, priority);
+  return handle;
+}
+
+template <class word, class env_type>
+const word &basic_fusion_queue<word, env_type>::peek_min() const {
+  if (sz == 0) throw(string("the queue is empty"));
+  return min_priority;
+}
+
+// the entry of the smallest priority that was added last to its bucket
+
+template <class word, class env_type>
+const int basic_fusion_queue<word, env_type>::min_handle() const {
+  if (sz == 0) throw(string("the queue is empty"));
+  return buckets.find(min_priority)->second.back();
+}
+
+template <class word, class env_type>
+int basic_fusion_queue<word, env_type>::pop_min() {
+  int handle = min_handle();
+  remove_from_bucket(handle);
+  free_handles.push_back(handle);
+  return handle;
+}
+
+template <class word, class env_type>
+const word &basic_fusion_queue<word, env_type>::priority(int handle) const {
+  check_handle(handle);
+  return entries[handle].priority;
+}
+
+// moves the entry to the bucket of its new priority
+
+template <class word, class env_type>
+void basic_fusion_queue<word, env_type>::decrease_key(int handle,
+                                                      const word &priority) {
+  check_handle(handle);
+  if (entries[handle].priority < priority) {
+    throw(string("decrease_key cannot increase a priority"));
+  }
+  if (entries[handle].priority == priority) return;
+  remove_from_bucket(handle);
+  add_to_bucket(handle, priority);
+}
+
+// queue constructor
+// the tree starts with no priorities
+
+template <class word, class env_type>
+basic_fusion_queue<word, env_type>::basic_fusion_queue(
+    const env_type *my_env_)
+    : my_env(my_env_), sz(0) {
+  vector<word> none;
+  tree = new btree_type(none, my_env);
+}
+
+// queue destructor
+
+template <class word, class env_type>
+basic_fusion_queue<word, env_type>::~basic_fusion_queue() {
+  delete tree;
+}
+
+// the queue over the default big_int is compiled once, in fusion_queue.cpp
+extern template class basic_fusion_queue<big_int>;
+
+#endif /* fusion_queue_hpp */
@@ -0,0 +1,24 @@
+//
+//  fusion_sort.cpp
+//  Fusion Tree
+//
+
+#include "fusion_sort.hpp"
+
+// compiles the sort over the default big_int, so that programs using it do
+// not need to instantiate it again
+template void fusion_sort<big_int, environment>(vector<big_int> &,
+                                                const environment *);
+
+// the default environment is built once, at the first sort, and only read
+// afterwards, so the sorts of many threads can share it
+
+void fusion_sort(vector<big_int> &keys) {
+  static const environment default_env;
+  for (int i = 0; i < (int)keys.size(); i++) {
+    if (keys[i].next_set_bit(default_env.element_size) != -1) {
+      throw(string("a key is too large for the default environment"));
+    }
+  }
+  fusion_sort(keys, &default_env);
+}
@@ -0,0 +1,136 @@
+//
+//  fusion_sort.hpp
+//  Fusion Tree
+//
+
+#ifndef fusion_sort_hpp
+#define fusion_sort_hpp
+
+#include <algorithm>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+
+using namespace std;
+
+// sorting of wide integers with fusion trees, in the way of the fusion sort of
+// Fredman and Willard. A range of keys is split into buckets by a sample of
+// splitters kept in a fusion B-tree, so that the bucket of a key is found with
+// O(log s / log capacity) node queries for s splitters. Keys equal to a
+// splitter go to a bucket of their own, which is already sorted, and the other
+// buckets are sorted in the same way, down to FUSION_SORT_CUTOFF keys, which
+// are sorted with std::sort. The capacity of the nodes is fixed by the
+// environment, at most 5, so log capacity is a constant and the sort takes
+// O(n log n) time, as a comparison sort does. Each node query costs far more
+// than a comparison on this simulated word RAM, so the sort is slower than
+// std::sort, see bench_sort.cpp
+
+// number of keys up to which a range is sorted with std::sort. It is also the
+// expected number of keys between two splitters
+#define FUSION_SORT_CUTOFF 64
+
+// number of keys sampled for each splitter. The splitters are the medians of
+// groups of sampled keys, so that the buckets have similar sizes
+#define FUSION_SORT_OVERSAMPLING 4
+
+// sorts keys in increasing order. Every key must fit in the element_size bits
+// of the environment, as the elements of a fusion tree
+template <class word, class env_type>
+void fusion_sort(vector<word> &keys, const env_type *my_env);
+
+// sorts keys over the default environment, whose elements have 3136 bits.
+// Throws a string if a key has a bit set above them
+void fusion_sort(vector<big_int> &keys);
+
+// sorts keys[begin] to keys[end - 1], using buffer, of the size of keys, to
+// move the keys to their buckets
+template <class word, class env_type>
+void fusion_sort_range(vector<word> &keys, int begin, int end,
+                       const env_type *my_env, vector<word> &buffer);
+
+template <class word, class env_type>
+void fusion_sort(vector<word> &keys, const env_type *my_env) {
+  vector<word> buffer(keys.size());
+  fusion_sort_range(keys, 0, keys.size(), my_env, buffer);
+}
+
+// splits the range into 2s + 1 buckets around s splitters: the keys smaller
+// than the first splitter, then, for each splitter, the keys equal to it and
+// the keys between it and the next one. Every bucket that is sorted again
+// misses at least one splitter, so the recursion always ends
+
+template <class word, class env_type>
+void fusion_sort_range(vector<word> &keys, int begin, int end,
+                       const env_type *my_env, vector<word> &buffer) {
+  int n = end - begin;
+  if (n <= FUSION_SORT_CUTOFF) {
+    std::sort(keys.begin() + begin, keys.begin() + end);
+    return;
+  }
+
+  // the sample is spread over the whole range
+  int sample_size = n / FUSION_SORT_CUTOFF * FUSION_SORT_OVERSAMPLING;
+  vector<word> splitters;
+  splitters.reserve(sample_size);
+  for (int i = 0; i < sample_size; i++) {
+    splitters.push_back(keys[begin + (long long)i * n / sample_size]);
+  }
+  std::sort(splitters.begin(), splitters.end());
+  int kept = 0;
+  for (int i = FUSION_SORT_OVERSAMPLING / 2; i < sample_size;
+       i += FUSION_SORT_OVERSAMPLING) {
+    if (kept == 0 or splitters[kept - 1] != splitters[i]) {
+      splitters[kept++] = splitters[i];
+    }
+  }
+  splitters.resize(kept);
+
+  // the rank of the predecessor of each key among the splitters. The
+  // splitters are sorted and distinct, so the B-tree keeps them as they are
+  vector<int> ranks(n);
+  {
+    basic_fusion_btree<word, env_type> tree(splitters, my_env);
+    tree.find_predecessor_batch(&keys[begin], n, ranks.data());
+  }
+
+  int bucket_count = 2 * kept + 1;
+  vector<int> buckets(n);
+  vector<int> offsets(bucket_count + 1, 0);
+  for (int i = 0; i < n; i++) {
+    int r = ranks[i];
+    if (r < 0) {
+      buckets[i] = 0;
+    } else if (keys[begin + i] == splitters[r]) {
+      buckets[i] = 2 * r + 1;
+    } else {
+      buckets[i] = 2 * r + 2;
+    }
+    offsets[buckets[i] + 1]++;
+  }
+  for (int b = 0; b < bucket_count; b++) {
+    offsets[b + 1] += offsets[b];
+  }
+
+  // the keys are moved to their buckets in the buffer, and back
+  vector<int> next(offsets.begin(), offsets.end() - 1);
+  for (int i = 0; i < n; i++) {
+    buffer[begin + next[buckets[i]]++] = keys[begin + i];
+  }
+  std::copy(buffer.begin() + begin, buffer.begin() + end,
+            keys.begin() + begin);
+
+  for (int b = 0; b < bucket_count; b += 2) {
+    if (offsets[b + 1] - offsets[b] > 1) {
+      fusion_sort_range(keys, begin + offsets[b], begin + offsets[b + 1],
+                        my_env, buffer);
+    }
+  }
+}
+
+// the sort over the default environment is compiled once, in fusion_sort.cpp
+extern template void fusion_sort<big_int, environment>(vector<big_int> &,
+                                                       const environment *);
+
+#endif /* fusion_sort_hpp */
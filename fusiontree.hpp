@@ -9,119 +9,2089 @@
 #define fusiontree_hpp
 
 #include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 #include <memory>
 #include <vector>
 
 #include "big_int.hpp"
+#include "fusion_file.hpp"
 
 using namespace std;
-class environment {
+
+// number of 64-bit lanes compared at once by count_lanes_not_greater
+#define LANES 4
+
+// returns the number of the n values in lanes that are not greater than x. All
+// of them must be smaller than 2^63, and n a multiple of LANES. The values are
+// compared one at a time
+static inline int count_lanes_not_greater_scalar(const uint64_t *lanes, int n,
+                                                 uint64_t x) {
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    count += (lanes[i] <= x);
+  }
+  return count;
+}
+
+#if defined(__x86_64__)
+// returns the number of the n values in lanes that are not greater than x,
+// comparing LANES of them with x at once with AVX2. The values are smaller
+// than 2^63, so the signed comparison of AVX2 orders them correctly. It may
+// only be called if cpu_supports_avx2()
+__attribute__((target("avx2"))) static inline int count_lanes_not_greater_simd(
+    const uint64_t *lanes, int n, uint64_t x) {
+  __m256i query = _mm256_set1_epi64x(x);
+  int greater = 0;
+  for (int i = 0; i < n; i += LANES) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(lanes + i));
+    // each lane of the mask is all ones if the value is greater than x, and
+    // movemask takes the sign bit of each lane
+    __m256i mask = _mm256_cmpgt_epi64(block, query);
+    greater +=
+        __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+  }
+  return n - greater;
+}
+#endif
+
+// ways in which the fusion trees over an environment sketch their elements
+enum sketch_mode {
+  auto_sketching,        // exact sketches if the processor supports BMI2, and
+                         // approximate sketches otherwise
+  exact_sketching,       // the important bits packed together, gathered with
+                         // pext, or one at a time without BMI2
+  approximate_sketching  // the important bits spread by a multiplication by m
+};
+
+// ways in which the fusion trees over an environment find their important bits
+// and m when they are built
+enum construction_mode {
+  adjacent_construction,  // the first different bits of adjacent elements,
+                          // with the set and clear bits of the masks found
+                          // limb by limb
+  pairwise_construction   // as the first version: every pair of elements is
+                          // compared and the bits are tested one at a time
+};
+
+// bitmasks used by fast_most_significant_bit, which only depend on the element
+// size. They are found once, and then copied into the environment
+template <class word>
+struct environment_masks {
+  // integers used by fast_most_significant_bit
+  word clusters_first_bits, perfect_sketch_m;
+  // integers used in parallel comparison by cluster_most_significant_bit
+  word repeat_int, powers_of_two, interposed_bits, cluster_bits,
+      cluster_sum_bits;
+
+  // finds the bitmasks for the given element size
+  environment_masks(int element_size);
+
+  // bitmasks left zero, to be set by the caller
+  environment_masks() {}
+};
+
+// constants of the computational environment of a fusion tree whose words are
+// of type word, which must provide the operators of big_int. Every member is
+// const, so an environment cannot change after it is built, and any number of
+// fusion trees and threads can share it
+template <class word>
+class basic_environment {
  public:
-  int word_size;     // Size of the type being used as big int, in bits
-  int element_size;  // Size of the element of the fusion_tree, must be a square
-  int sqrt_element_size;  // Value of sqrt(element_size), necessary for most
-                          // significant bit
-  int capacity;           // maximum number of integers in a fusion tree
-
-  // bitmasks precalculated to avoid use of <<
-  big_int *shift_1, *shift_neg_1, *shift_neg_0;
+  const int word_size;     // Size of the type being used as big int, in bits
+  const int element_size;  // Size of the element of the fusion_tree, must be
+                           // a square
+  const int sqrt_element_size;  // Value of sqrt(element_size), necessary for
+                                // most significant bit
+  const int capacity;           // maximum number of integers in a fusion tree
+  const sketch_mode sketching;  // how the fusion trees built over the
+                                // environment sketch their elements
+  const construction_mode construction;  // how the fusion trees built over
+                                         // the environment are built
+
+  // bitmasks precalculated to avoid use of <<. They are NULL in a
+  // static_environment, which computes them from the index
+  const word *const shift_1, *const shift_neg_1, *const shift_neg_0;
   // integers used by fast_most_significant_bit
-  big_int clusters_first_bits, perfect_sketch_m;
+  const word clusters_first_bits, perfect_sketch_m;
   // integers used in parallel comparison by cluster_most_significant_bit
-  big_int repeat_int;       // integer used by parallel comparison
-                            // to repeat a number multiple times
-  big_int powers_of_two;    // bitmask with the powers of two
-                            // in ascending order
-  big_int interposed_bits;  // bitmask used to extract the bits
-                            // interposed among the repetitions of a
-                            // number
-
-  environment(int word_size_ = 4000, int element_size_ = 3136,
-              int capacity_ = 5);
-  ~environment();
+  const word repeat_int;       // integer used by parallel comparison
+                               // to repeat a number multiple times
+  const word powers_of_two;    // bitmask with the powers of two
+                               // in ascending order
+  const word interposed_bits;  // bitmask used to extract the bits
+                               // interposed among the repetitions of a
+                               // number
+  const word cluster_bits;      // bitmask of the first sqrt_element_size bits
+  const word cluster_sum_bits;  // bitmask of the first sqrt_element_size + 1
+                                // bits
+  // multipliers by the sparse constants above, doing one shifted addition for
+  // each of their set bits
+  const sparse_multiplier repeat_int_multiplier, perfect_sketch_m_multiplier;
+
+  basic_environment(int word_size_ = word::bits, int element_size_ = 3136,
+                    int capacity_ = 5, sketch_mode sketching_ = auto_sketching,
+                    construction_mode construction_ = adjacent_construction);
+  ~basic_environment();
 
   // first step of fast_most_significant_bit
-  const int cluster_most_significant_bit(big_int x) const;
+  const int cluster_most_significant_bit(word x) const;
+
+  // find the most significant bit of a word in O(1) in word RAM model. This
+  // is the reference implementation of fast_most_significant_bit
+  const int word_ram_most_significant_bit(word const &x) const;
 
-  // find the most significant bit of a big_int in O(1) in word RAM model
-  const int fast_most_significant_bit(big_int const &x) const;
+  // find the most significant bit of a word. When compiled with NAIVE=1 it
+  // uses the native count leading zeros instruction over the limbs of x,
+  // otherwise it uses word_ram_most_significant_bit
+  const int fast_most_significant_bit(word const &x) const;
 
-  // find the longest common prefix between two big_ints in O(1) in word RAM
-  // model
-  const int fast_first_diff(big_int const &x, big_int const &y) const;
+  // find the longest common prefix between two words in O(1) in word RAM
+  // model. When compiled with NAIVE=1 it scans the limbs of x and y for the
+  // first one in which they differ
+  const int fast_first_diff(word const &x, word const &y) const;
+
+ protected:
+  // environment constructor that takes the bitmasks of
+  // fast_most_significant_bit instead of finding them, and only builds the
+  // tables shift_1, shift_neg_1 and shift_neg_0 if build_tables is true.
+  // Otherwise they are left NULL, for environments that compute those bitmasks
+  // from the index
+  basic_environment(int word_size_, int element_size_, int capacity_,
+                    sketch_mode sketching_, construction_mode construction_,
+                    bool build_tables, const environment_masks<word> &masks);
+
+ private:
+  // returns a new table with base << i, for each i below word_size
+  static const word *shift_table(const word &base, int word_size);
+
+  // an environment owns its tables, so it cannot be copied
+  basic_environment(const basic_environment &);
+  basic_environment &operator=(const basic_environment &);
 };
 
-class fusiontree {
+// fusion tree node over words of type word. A node only keeps what the
+// queries need: its elements, in an array of capacity words, four words of
+// masks and a 64-bit lane with the sketch of each element. The integers used
+// only to build them, like m and the indices of the important bits, are
+// discarded after the construction. The const methods only read the node and
+// its environment, so any number of threads can query the same node at once,
+// as long as no thread calls insert or erase meanwhile
+template <class word, class env_type = basic_environment<word> >
+class basic_fusiontree {
  private:
-  environment *my_env;  // object with the specifications of the fusion tree
+  const env_type *my_env;  // object with the specifications of the fusion
+                           // tree. It is only read, never changed
+  shared_ptr<const env_type> env_owner;  // keeps my_env alive when the fusion
+                                         // tree shares its ownership, empty
+                                         // otherwise
+
+  word data;  // sketched integers
 
-  big_int data;  // sketched integers
+  word *elements;  // array with the original values of the elements of the
+                   // fusiontree, with room for capacity elements
+  int sz;          // size of tree
+  bool owns_elements;  // whether elements was allocated by the fusion tree. A
+                       // fusion tree read from a file reads its elements in
+                       // place, until insert or erase change them
 
-  big_int *elements;  // array with the original values of the elements of the
-                      // fusiontree
-  int sz;             // size of tree
+  word extract_interposed_bits;  // bitmask used to extract the bits
+                                 // interposed among the repetitions of a
+                                 // number
+  sparse_multiplier repeat_int_multiplier;  // multiplies by the integer that
+                                            // repeats a number multiple times
 
-  big_int repeat_int;                   // integer used by parallel comparison
-                                        // repeats a number multiple times
-  big_int extract_interposed_bits;      // bitmask used to extract the bits
-                                        // interposed among the repetitions of a
-                                        // number
-  big_int extract_interposed_bits_sum;  // bitmask used to extract the sum of
-                                        // bits interposed among the repetitions
-                                        // of a number, after having gathering
-                                        // them together
+  word sketch_mask;                // mask of all the m_i+b_i sums
+  sparse_multiplier m_multiplier;  // multiplies by m, one addition per m_i
+  int sketch_shift;                // b_0+m_0, the position of the lowest bit
+                                   // of the sketch in x*m
 
-  big_int m;            // integer m
-  int *m_indices;       // array to keep the position of the set bits of m
-  big_int sketch_mask;  // mask of all the m_i+b_i sums
+  int important_bits_count;  // number of important bits
+  word mask_important_bits;  // mask of important bits
 
-  int important_bits_count;     // number of important bits
-  big_int mask_important_bits;  // mask of important bits
-  int *important_bits;  // indexes of the important bits of the elements in the
-                        // fusion tree
+  bool exact_sketches;  // whether the sketches are gathered exactly with pext
+                        // instead of approximated with a multiplication by m
+  int sketch_size;      // number of bits of each sketch stored in data
+
+  vector<uint64_t> sketch_lanes;  // sketch of each element in a 64-bit lane,
+                                  // in increasing order, followed by lanes
+                                  // larger than any sketch up to a multiple of
+                                  // LANES. Empty if the sketches do not fit
+  int search;  // search_mode used by find_sketch_predecessor when the sketches
+               // fit in the lanes
 
   // add numbers from a vector to array elements
-  void add_in_array(vector<big_int> &elements_);
+  void add_in_array(vector<word> &elements_);
+
+  // copies the elements read in place into an array of the fusion tree, with
+  // room for capacity elements, so that they can be changed
+  void own_elements();
 
-  // finds the important bits of a set of integers
-  void find_important_bits();
+  // finds the important bits of a set of integers, and keeps their indexes in
+  // important_bits
+  void find_important_bits(vector<int> &important_bits);
+
+  // find_important_bits with pairwise_construction
+  void find_important_bits_pairwise(vector<int> &important_bits);
 
   // finds an integer m and sketch_mask to be used for sketching
-  void find_m();
+  void find_m(const vector<int> &important_bits);
 
   // sets the variables used in parallel comparison
   void set_parallel_comparison();
 
+  // finds the important bits, m and the variables used in parallel comparison
+  // of the elements currently in array elements, from scratch
+  void build_sketches();
+
+  // moves the sketches in data to make room for a new element in position
+  // idx, and adds the sketch of x there
+  void insert_in_data(int idx, const word &x);
+
+  // moves the sketches in data to remove the element in position idx
+  void erase_from_data(int idx);
+
   // returns the approximate sketch, in the fusion tree, of a given number
-  const big_int approximate_sketch(const big_int &x) const;
+  const word approximate_sketch(const word &x) const;
+
+  // returns the exact sketch of a given number, i.e., its important bits
+  // packed together, gathered with pext
+  const word exact_sketch(const word &x) const;
+
+  // returns the sketch used by the fusion tree, either exact or approximate
+  const word sketch(const word &x) const;
+
+  // returns the sketch of the element in position i, kept in data
+  const word stored_sketch(int i) const;
+
+  // returns the sketch of a given number as a lane of sketch_lanes
+  const uint64_t lane_sketch(const word &x) const;
+
+  // fills sketch_lanes with the sketches of the elements, if they fit
+  void set_sketch_lanes();
+
+  // returns the number of bits of each sketch in data for the given number
+  // of important bits, with exact or approximate sketches
+  const int sketch_size_for(int bits_count, bool exact) const;
+
+  // returns the number of lanes of sketch_lanes for sketches of the given
+  // size, zero if they do not fit in a lane
+  const int lane_count_for(int sketch_size_) const;
 
-  // returns an integer with O(w^(1/5)) sketches of x, separated by zeroes
-  const big_int multiple_sketches(const big_int &x) const;
+  // checks the words read from a node record against its elements, given the
+  // indices of the important bits and of the set bits of m kept in the record.
+  // Throws a string if they are not the ones the elements lead to
+  void check_record(const uint64_t *indices, const word &m) const;
+
+  // keeps in res an integer with O(w^(1/5)) repetitions of a sketch, separated
+  // by zeroes
+  void multiple_sketches(const word &sketch_x, word &res) const;
 
   // returns the index of the biggest y in the tree succh that
   // sketch(y)<=sketch(x)
-  const int find_sketch_predecessor(const big_int &x) const;
+  const int find_sketch_predecessor(const word &x) const;
+
+  // find_sketch_predecessor with the parallel comparison in the word data
+  const int word_ram_sketch_predecessor(const word &x) const;
+
+  // number of queries whose stages are interleaved in find_predecessor_batch
+  static const int batch_block = 16;
+
+  // returns the lowest common ancestor of x with the elements next to its
+  // sketch predecessor idx1, i.e., their first different bit with x. If x is
+  // one of them, returns -1 and keeps its index in answer
+  const int find_lca(const word &x, int idx1, int &answer) const;
+
+  // returns the integer whose sketch predecessor leads to the predecessor of x,
+  // given the lowest common ancestor of x with the elements
+  const word find_lca_key(const word &x, int lca) const;
+
+  // fixes the sketch predecessor of the integer returned by find_lca_key into
+  // the predecessor of x
+  const int fix_lca_answer(const word &x, int lca, int answer) const;
+
+  // returns the number of integers in the tree smaller than x, as rank, but
+  // counting its operations in the site of the caller
+  const int rank_of(const word &x) const;
+
+  // returns the rank of b, given first, the rank of a<b. The rank of b is only
+  // queried when the element of rank first is smaller than b
+  const int range_end(const word &b, int first) const;
 
  public:
+  // ways in which find_sketch_predecessor compares a sketch with the sketches
+  // of the elements
+  enum search_mode {
+    word_ram_search,  // parallel comparison in the word data, with a
+                      // multiplication, in O(1) word operations
+    lane_search,      // comparison with the sketches in 64-bit lanes, one at
+                      // a time
+    simd_search       // comparison with LANES lanes at once, with AVX2
+  };
+
+  // selects how the sketch predecessor is found. Returns false, without
+  // changing it, if simd_search is asked on a processor without AVX2. The
+  // lanes are only used while the sketches take less than 63 bits, which is
+  // always the case for exact sketches. Otherwise word_ram_search is used.
+  // By default, simd_search is used if the processor supports it, and
+  // lane_search otherwise
+  bool set_search_mode(search_mode mode);
+
+  // returns the search mode selected
+  search_mode get_search_mode() const;
+
+  // returns how the elements are sketched: exact_sketching or
+  // approximate_sketching. It is chosen by the environment when the fusion
+  // tree is built, or read from its record
+  sketch_mode get_sketch_mode() const;
+
+  // iterator over the elements of the fusion tree, in increasing order
+  typedef const word *const_iterator;
+
+  // elements of the fusion tree in an interval, which can be used in a range
+  // based for loop
+  struct range {
+    const_iterator first;  // first element in the interval
+    const_iterator last;   // position after the last element in the interval
+
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return last; }
+  };
+
   // returns the number of integers stored
   const int size() const;
 
   // returns the number in a given position in the tree
-  const big_int pos(int i) const;
+  const word pos(int i) const;
 
   // returns the index of the biggest k in the tree succh that k<=x
   // or -1 if there is no such k
-  const int find_predecessor(const big_int &x) const;
+  const int find_predecessor(const word &x) const;
+
+  // finds the predecessor of each of the n integers in queries, as
+  // find_predecessor, and keeps them in out. The stages of consecutive queries
+  // are interleaved, so that their independent operations overlap
+  void find_predecessor_batch(const word *queries, int n, int *out) const;
+
+  // returns the index of the smallest k in the tree such that k>=x
+  // or -1 if there is no such k
+  const int find_successor(const word &x) const;
+
+  // returns the number of integers in the tree smaller than x
+  const int rank(const word &x) const;
+
+  // returns the number of integers k in the tree such that a<=k<b
+  const int count_range(const word &a, const word &b) const;
+
+  // returns the integers k in the tree such that a<=k<b
+  const range find_range(const word &a, const word &b) const;
+
+  // iterators to the first element and to the position after the last element
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // inserts x in the fusion tree. Returns false, without changing it, if x is
+  // already stored or if the fusion tree is full
+  bool insert(const word &x);
+
+  // removes x from the fusion tree. Returns false if x is not stored
+  bool erase(const word &x);
+
+  // returns the number of bytes of the node record written by serialize
+  size_t serialized_size() const;
+
+  // writes the node record of the fusion tree, described in fusion_file.hpp, in
+  // out, which must have serialized_size() bytes and be aligned to 8 bytes
+  void serialize(char *out) const;
+
+  // writes the fusion tree to a file in path, which can be read back with
+  // mapped_file. Throws a string if the file cannot be written
+  void save(const char *path) const;
+
+  // fusiontree constructor over a node record written by serialize, as in a
+  // mapped file. The masks and the sketches are copied, without searching for
+  // m again, and the elements are read in place, so the record must outlive
+  // the fusion tree. The record is checked against its elements, which takes
+  // one sketch and one first different bit per element. Throws a string if
+  // the record is not consistent
+  basic_fusiontree(const char *record, const env_type *my_env_);
+
+  // fusiontree constructor over a file written by save. The file must outlive
+  // the fusion tree, and must have been written over an environment with the
+  // same parameters as my_env_. Throws a string otherwise
+  basic_fusiontree(const mapped_file &file_, const env_type *my_env_);
 
   // fusiontree constructor
-  // v_ is a vector with the integers to be stored
-  fusiontree(vector<big_int> &v_, environment *my_env_);
+  // v_ is a vector with the integers to be stored. The environment must
+  // outlive the fusion tree
+  basic_fusiontree(vector<word> &v_, const env_type *my_env_);
+
+  // fusiontree constructor that shares the ownership of the environment, so
+  // that it lives while any fusion tree over it does
+  basic_fusiontree(vector<word> &v_, shared_ptr<const env_type> my_env_);
+
+  // copy constructor. The copy has its own array of elements
+  basic_fusiontree(const basic_fusiontree &t);
+
+  // move constructor. The array of elements is taken from t, which is left
+  // as an empty fusion tree over the same environment, ready for inserts
+  basic_fusiontree(basic_fusiontree &&t) noexcept;
+
+  // copy and move assignments, which take t by value and swap with it
+  basic_fusiontree &operator=(basic_fusiontree t) noexcept;
+
+  // exchanges the contents of two fusion trees without copying the elements
+  void swap(basic_fusiontree &t) noexcept;
 
   // fusiontree destructor
-  ~fusiontree();
+  ~basic_fusiontree();
 };
 
+// the environment and fusion tree over the default big_int
+typedef basic_environment<big_int> environment;
+typedef basic_fusiontree<big_int> fusiontree;
+
+// prints all the numbers, in binary form, in a fusion tree
+template <class word, class env_type>
+std::ostream &operator<<(std::ostream &out,
+                         const basic_fusiontree<word, env_type> &t);
+
+// environment constructor
+// also initializes the tricks of the environment
+template <class word>
+basic_environment<word>::basic_environment(int word_size_, int element_size_,
+                                           int capacity_,
+                                           sketch_mode sketching_,
+                                           construction_mode construction_)
+    : basic_environment(word_size_, element_size_, capacity_, sketching_,
+                        construction_, true,
+                        environment_masks<word>(element_size_)) {}
+
+// environment constructor over bitmasks already found. The members are const,
+// so all of them are set before the restrictions are checked
+template <class word>
+basic_environment<word>::basic_environment(int word_size_, int element_size_,
+                                           int capacity_,
+                                           sketch_mode sketching_,
+                                           construction_mode construction_,
+                                           bool build_tables,
+                                           const environment_masks<word> &masks)
+    : word_size(word_size_),
+      element_size(element_size_),
+      sqrt_element_size(sqrt(element_size_)),
+      capacity(capacity_),
+      sketching(sketching_),
+      construction(construction_),
+      shift_1(build_tables ? shift_table(word(1), word_size_) : NULL),
+      shift_neg_1(build_tables ? shift_table(~word(1), word_size_) : NULL),
+      shift_neg_0(build_tables ? shift_table(~word(0), word_size_) : NULL),
+      clusters_first_bits(masks.clusters_first_bits),
+      perfect_sketch_m(masks.perfect_sketch_m),
+      repeat_int(masks.repeat_int),
+      powers_of_two(masks.powers_of_two),
+      interposed_bits(masks.interposed_bits),
+      cluster_bits(masks.cluster_bits),
+      cluster_sum_bits(masks.cluster_sum_bits),
+      repeat_int_multiplier(masks.repeat_int),
+      perfect_sketch_m_multiplier(masks.perfect_sketch_m) {
+  // check if restrictions were not violated, and raise error otherwise
+  try {
+    if (word_size > word::bits) {
+      throw(string("word_size is larger than the size of the word type"));
+    }
+    if (sqrt_element_size * sqrt_element_size != element_size) {
+      throw(string("element_size is not a square"));
+    }
+    int capacity_to_4 = capacity * capacity * capacity * capacity;
+    int capacity_to_5 = capacity_to_4 * capacity;
+    if (capacity_to_5 > element_size) {
+      throw(string("element_size is too small for the fusion tree capacity"));
+    }
+
+    if (capacity_to_5 + capacity_to_4 > word_size) {
+      throw(string("word_size is too small for the fusion tree capacity"));
+    }
+  } catch (const string msg) {
+    cerr << msg << endl;
+  }
+}
+
+// returns a new table of word_size bitmasks, used to avoid the use of <<
+template <class word>
+const word *basic_environment<word>::shift_table(const word &base,
+                                                 int word_size) {
+  word *table = new word[word_size];
+  for (int i = 0; i < word_size; i++) {
+    table[i] = (base << i);
+  }
+  return table;
+}
+
+// finds the bitmasks used by fast_most_significant_bit. They are built with |
+// from zero, and do not use the tables, since they may not be built
+template <class word>
+environment_masks<word>::environment_masks(int element_size) {
+  int sqrt_element_size = sqrt(element_size);
+
+  // Find the value of clusters_first_bits
+  for (int i = 0; i < sqrt_element_size; i++) {
+    // for each cluster of bits of size sqrt_element_size
+    // add the first bit of the cluster in the bitmask clusters_first_bits
+    clusters_first_bits =
+        clusters_first_bits |
+        (word(1) << (sqrt_element_size - 1 + i * sqrt_element_size));
+  }
+
+  // Find the value of perfect_sketch_m, which we use to sketch the first bits
+  // of the clusters of size sqrt_element_size. Note that the important bits are
+  // such that. We will use m_i = element_size - (sqrt_element_size - 1) - i *
+  // sqrt_element_size + i.
+  for (int i = 0; i < sqrt_element_size; i++) {
+    // for each b_i, just apply the formula
+    perfect_sketch_m =
+        perfect_sketch_m | (word(1) << (element_size - (sqrt_element_size - 1) -
+                                        i * sqrt_element_size + i));
+  }
+
+  // Find the value of interposed_bits
+  for (int i = 0; i < sqrt_element_size; i++) {
+    interposed_bits =
+        interposed_bits |
+        (word(1) << (sqrt_element_size + i * (sqrt_element_size + 1)));
+  }
+
+  // Find the value of repeat_int
+  for (int i = 0; i < sqrt_element_size; i++) {
+    repeat_int = repeat_int | (word(1) << (i * (sqrt_element_size + 1)));
+  }
+
+  // Find the value of powers_of_two
+  for (int i = 0; i < sqrt_element_size; i++) {
+    powers_of_two =
+        powers_of_two |
+        (word(1) << (sqrt_element_size - i - 1 + i * (sqrt_element_size + 1)));
+  }
+
+  // Find the values of cluster_bits and cluster_sum_bits
+  cluster_bits = ~(~word(0) << sqrt_element_size);
+  cluster_sum_bits = ~(~word(0) << (sqrt_element_size + 1));
+}
+
+// environment deconstructor
+// It just needs to free the dynamically allocated arrays in the class
+template <class word>
+basic_environment<word>::~basic_environment() {
+  // use free to delete an array
+  delete[] shift_1;
+  delete[] shift_neg_1;
+  delete[] shift_neg_0;
+}
+
+// returns the most significant bit of a cluster of bits of size
+// sqrt_element_size. It basically uses parallel comparison to determine
+// the greatest power of two that is not greater than the cluster
+template <class word>
+const int basic_environment<word>::cluster_most_significant_bit(word x) const {
+  // creates sqrt repetitions of cluster x, with one bit between consecutive
+  // repetiitions
+  word y;
+  repeat_int_multiplier.multiply(x, y);
+  // set the bits between repetitions and calculate the difference between the
+  // result and powers_of_two. The interposed bit before repetition i will
+  // remain significant if 2^i is smaller than or equal to x. Then extract all
+  // the bits interposed among the repetitions of x. The three steps are a
+  // single expression, computed in one pass over the limbs
+  x = ((y | interposed_bits) - powers_of_two) & interposed_bits;
+  // the number of significant bits is the number of powers smaller then
+  // x. Multiply the extracted bits by repeat_int to make then add up
+  // together before the first interposed bit
+  repeat_int_multiplier.multiply(x, y);
+  // shift the result to the right to ignore the trash created after the first
+  // interposed bit, and extract only the the number of bits in a cluster to
+  // ignore trash created before the interval where the extracted bits were
+  // added. The number of powers of two which are not greater than x,
+  // subtracted by 1, is the greatest power of two which is not greater than x,
+  // i.e., the index of the most significant bit of the cluster. It is in the
+  // lowest bits, so only the lowest limb of the expression is computed
+  return (int)((y >> ((element_size) + (sqrt_element_size - 1))) &
+               cluster_sum_bits) -
+         1;
+}
+
+// find the most significant bit of a word in O(1) in word RAM model
+template <class word>
+const int basic_environment<word>::word_ram_most_significant_bit(
+    word const &x) const {
+  // We will divide our number x of size element_size in sqrt_element_size
+  // clusters of bits of size sqrt_element_size.
+  // Extract the first bit of each cluster
+  word x_clusters_first_bits = x & clusters_first_bits;
+
+  // use XOR between x and the last result to make the first bit of each cluster
+  // insignificant, i.e., consider only the rest of the cluster. Subtract the
+  // remains of the clusters from clusters_first_bits and only the clusters
+  // with significant bits in their remains will have a zero as their first
+  // bit. Extract only those first bits, and use an XOR with
+  // cluster_first_bits to swap their value. Now the first bit is 1 if there is
+  // any significant bit in the rest of the cluster. Then, an OR operator with
+  // the first bits of the clusters will result in an integer in which the
+  // first bit of each cluster is 1 if there is any significant bit in that
+  // cluster. All these steps are computed in a single pass over the limbs
+  word x_significant_clusters =
+      (((clusters_first_bits - (x ^ x_clusters_first_bits)) &
+        clusters_first_bits) ^
+       clusters_first_bits) |
+      x_clusters_first_bits;
+
+  // Then we have to sketch x_significant_clusters
+  // We are using m_i = element_size - (sqrt_element_size - 1) - i *
+  // sqrt_element_size + i. Note that, since b_i = sqrt_element_size - 1 + i *
+  // sqrt_element_size, we have that m_i + b_i = element_size+1, so if we shift
+  // x * perfect_sketch_m to the right by element_size bits, we already have the
+  // sketch. We only have to extract the last sqrt_element_size bits.
+  word sketch;
+  perfect_sketch_m_multiplier.multiply(x_significant_clusters, sketch);
+
+  // to find the index of the most significant cluster, i.e., the first cluster
+  // with significant bits, we only have to find the most_significant_bit of
+  // the sketch. Since we only have sqrt_element_size bits, we can use the
+  // function cluster_most_significant_bit to do it
+  int most_significant_cluster_idx =
+      cluster_most_significant_bit((sketch >> element_size) & cluster_bits);
+
+  // Then we will extract only the bits of the most significant cluster and
+  // shift the number to the right until it becomes the first cluster
+  word most_significant_cluster =
+      (x >> (most_significant_cluster_idx * sqrt_element_size)) & cluster_bits;
+
+  // Now we only have to find the most significant bit of that cluster, which,
+  // again, can be done using cluster_most_significant_bit. Since we know the
+  // original index of the cluster, it is easy to know the original index of its
+  // most significant bit and keep it in ans
+  int ans = most_significant_cluster_idx * sqrt_element_size +
+            cluster_most_significant_bit(most_significant_cluster);
+
+  // if answer is negative, then there is no most significant bit, i.e., the
+  // number is zero. Set ans to -1
+  if (ans < 0) {
+    ans = -1;
+  }
+
+  // return ans
+  return ans;
+}
+
+// find the most significant bit of a word, either with native instructions or
+// with the word RAM routine
+template <class word>
+const int basic_environment<word>::fast_most_significant_bit(
+    word const &x) const {
+  COUNT_SITE(site_most_significant_bit);
+#if NAIVE
+  return x.most_significant_bit();
+#else
+  return word_ram_most_significant_bit(x);
+#endif
+}
+
+// find the longest common prefix between two words in O(1) in word RAM model
+template <class word>
+const int basic_environment<word>::fast_first_diff(word const &x,
+                                                  word const &y) const {
+  COUNT_SITE(site_first_diff);
+#if NAIVE
+  // scan the limbs from the most significant one, without building x XOR y
+  return x.first_diff(y);
+#else
+  // the first different bit between two integers x and y is the most
+  // significant bit in x XOR y
+  return fast_most_significant_bit(x ^ y);
+#endif
+}
+
+// add numbers from a vector to array elements
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::add_in_array(vector<word> &elements_) {
+  // sets variable sz, which keeps the size of the fusion tree
+  sz = elements_.size();
+
+  // copies all the elements from the vector to array elements
+  for (int i = 0; i < elements_.size(); i++) {
+    elements[i] = elements_[i];
+  }
+
+  // sorts the array elements in ascending order
+  std::sort(elements, elements + size());
+}
+
+// finds the important bits of a set of integers
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::find_important_bits(
+    vector<int> &important_bits) {
+  COUNT_SITE(site_find_important_bits);
+  // if the fusion tree has a single element, there are no important bits
+  if (size() == 1) return;
+
+  // the first version compared every pair of elements
+  if (my_env->construction == pairwise_construction) {
+    find_important_bits_pairwise(important_bits);
+    return;
+  }
+
+  // the elements are sorted, so the first bit that differentiates an element
+  // from all the others is the first different bit between it and one of its
+  // neighbors, and the important bits are the first different bits between
+  // consecutive elements, found in k - 1 comparisons
+  for (int i = 1; i < size(); i++) {
+    mask_important_bits.set_bit(my_env->fast_first_diff(pos(i - 1), pos(i)));
+  }
+
+  // keep all the important bits found in array important_bits, in increasing
+  // order, and update the value of important_bits_count. The set bits of the
+  // mask are found limb by limb with count trailing zeros
+  for (int i = mask_important_bits.next_set_bit(0); i >= 0;
+       i = mask_important_bits.next_set_bit(i + 1)) {
+    important_bits.push_back(i);
+    important_bits_count++;
+  }
+}
+
+// finds the important bits as the first version did, comparing each element
+// with every element before it, and testing the bit positions one at a time
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::find_important_bits_pairwise(
+    vector<int> &important_bits) {
+  // insert the elements one by one and, for each of them, find the first
+  // bit that differentiates that element from any other element already
+  // inserted in the fusion tree
+  for (int i = 1; i < size(); i++) {
+    // for each element i, find where it first differentiates from the first
+    // element
+    int diff_point = my_env->fast_first_diff(pos(i), pos(0));
+
+    // then check if there is any other element that differentiate from i in a
+    // later bit
+    for (int j = 1; j < i; j++) {
+      // for each other element j
+      // find where it first differentiates from i
+      int temp = my_env->fast_first_diff(pos(i), pos(j));
+      // if it is later then the first element, keep the index of such bit
+      if (temp < diff_point) diff_point = temp;
+    }
+
+    // the first bit that differentiates element i from any other in the fusion
+    // tree is an important bit, so add it in mask_important_bits
+    mask_important_bits = mask_important_bits | my_env->shift_1[diff_point];
+  }
+
+  // keep all the important bits found in array important_bits and update the
+  // value of important_bits_count
+  for (int i = 0; i < my_env->word_size; i++) {
+    // foir each bit position i in the word size given
+    // if bit in position i is an important bit
+    if ((mask_important_bits & my_env->shift_1[i]) != word(0)) {
+      // add such position to array important_bits
+      important_bits.push_back(i);
+      // and update the value of important_bits_count
+      important_bits_count++;
+    }
+  }
+}
+
+// finds an integer m, used to find the sketch of a numeber, and sketch_mask,
+// used to extract the important bits from it
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::find_m(
+    const vector<int> &important_bits) {
+  COUNT_SITE(site_find_m);
+  // precalculates the third power of the number of important bits
+  int important_bits_count_to_3 =
+      important_bits_count * important_bits_count * important_bits_count;
+
+  // integer m and the positions of its set bits. They are only needed to build
+  // sketch_mask and m_multiplier, so they are not kept in the fusion tree
+  word m = 0;
+  vector<int> m_indices(important_bits_count);
+
+  // find the indices of the set bits in m
+  // tag is a bitmask used to denote that a certain position cannot be used
+  // anymore because it would cause a collision between the position of two
+  // distinct important bits after the multiplication by m to find the sketch of
+  // a number
+  word tag = 0;
+
+  // for every important bit b_i we will find an integer m_i such that b_i+m_i
+  // is distinct for all i, modulo capacity^3. If each m_i represents one set
+  // bit in m, it garantees that each important bit of the number x we are
+  // sketching will be taken to a different position in x*m
+  for (int i = 0; i < important_bits_count; i++) {
+    // for every important bit b_i
+    // we will search for the first position m_i available in m such that
+    // b_i+m_i is unique. If a position is not tagged, then it means there is
+    // no other pair b_j, m_j such that b_j+m_j=b_i+m_i thus this position can
+    // be m_i. It is garanteed that we will find enough all the values for all
+    // m_i in the first capacity^3 bit positions
+    int j = 0;
+    if (my_env->construction == pairwise_construction) {
+      while ((tag & my_env->shift_1[j]) != word(0)) j++;
+    } else {
+      // the first clear bit of tag is found limb by limb with count trailing
+      // zeros
+      j = tag.next_clear_bit(0);
+    }
+    m_indices[i] = j;
+
+    // then we need to tag every single position p such that b_i+m_i=b_j+p,
+    // for any pair of important bits b_i, b_j, so that p does not be chosen
+    // as any m_j. This is the same of tagging every position p such that
+    // m_i+b_i-b_j=p Thus, for every pair of important bits
+    for (int k1 = 0; k1 < important_bits_count; k1++) {
+      for (int k2 = 0; k2 < important_bits_count; k2++) {
+        // We tag the value of m_i+b_i-b_j modulo capacity^3, since the m_i
+        // will be spread by multiples of capacity^3 below and must still
+        // not collide after that
+        int p = (j + important_bits[k1] - important_bits[k2]) %
+                important_bits_count_to_3;
+        if (p < 0) p += important_bits_count_to_3;
+        // adding a bit in the bitmask tag
+        if (my_env->construction == pairwise_construction) {
+          tag = tag | (my_env->shift_1[p]);
+        } else {
+          tag.set_bit(p);
+        }
+      }
+    }
+  }
+  // we already have m_i+b_i distinct modulo capacity^3, now we have to spread
+  // the values of m_i+b_i such that each of them is in a distinct interval of
+  // size capacity^3, so that we can also maintain the order of the important
+  // bits in the sketch of x
+  for (int i = 0; i < important_bits_count; i++) {
+    // we want m_i+b_i to be in the interval i of capacity^3 bits, so we must
+    // add a multiple of capacity^3 to m_i that takes it to i*capacity^3-b_i.
+    // However it can be negative, so we will take m_i+b_i to the interval that
+    // starts at element_size+(i+1)*capacity^3 instead. Since b_i and the m_i
+    // found above are smaller than element_size and capacity^3, we add the
+    // smallest multiple of capacity^3 that makes m_i+b_i reach it
+    int interval_start =
+        my_env->element_size + (i + 1) * important_bits_count_to_3;
+    m_indices[i] = m_indices[i] +
+                   (important_bits_count_to_3 *
+                    ((interval_start - important_bits[i] - m_indices[i] +
+                      important_bits_count_to_3 - 1) /
+                     important_bits_count_to_3));
+    // then we set up the bit m_i of m
+    m = m | my_env->shift_1[m_indices[i]];
+
+    // then, we have to set sketch_mask, which is a bitmask that allows us to
+    // extract the important bits of x after we multiply x*m. It is easy to see
+    // that each bit b_i will be found in position b_i+m_i, thus we only have to
+    // set a bit mask with those bits
+    sketch_mask =
+        sketch_mask | (my_env->shift_1[important_bits[i] + m_indices[i]]);
+    // note that the distance between the first and last important bits is at
+    // most capacity*(capacity^3)=capacity^4. Since element_size > capacity^5,
+    // we can store all the sketches in a single element
+  }
+
+  // m only has important_bits_count set bits, so multiplying by it takes that
+  // many shifted additions
+  m_multiplier = sparse_multiplier(m);
+
+  // the lowest bit of the sketch is b_0 in position b_0+m_0 of x*m
+  if (important_bits_count > 0) sketch_shift = important_bits[0] + m_indices[0];
+}
+
+// sets the variable data that will keep the sketched numbers, as well as the
+// bit masks which are necessary for the parallel comparison
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::set_parallel_comparison() {
+  COUNT_SITE(site_set_parallel_comparison);
+  // an approximate sketch takes up to important_bits_count^4 bits, while an
+  // exact sketch takes important_bits_count bits. The sketches must also have
+  // room for the number of sketches added up in find_sketch_predecessor
+  sketch_size = sketch_size_for(important_bits_count, exact_sketches);
+
+  // set variable data
+  // for each element in the fusiontree, add their sketch to data
+  // approximate_sketch needs m_multiplier, which was set up by find_m
+  for (int i = 0; i < my_env->capacity; i++) {
+    // add the interposed bit right before the element sketch to be inserted
+    data = data | my_env->shift_1[(i + 1) * sketch_size + i];
+    // then add the element that is in position capacity - 1 - i (to be in
+    // decreasing order), in its right place. If the fusion tree is not full,
+    // the missing elements are treated as larger than any other, taking the
+    // largest possible sketch
+    if (my_env->capacity - 1 - i < size()) {
+      data = data | (sketch(pos(my_env->capacity - 1 - i))
+                     << i * (sketch_size + 1));
+    } else {
+      data = data | ((~my_env->shift_neg_0[sketch_size])
+                     << i * (sketch_size + 1));
+    }
+  }
+
+  // set bitmask repeat_int, which is a repetition of 000...01, to make a
+  // sequence if bits repeat itself multiple times, leaving one bit interposed
+  // between two repetitionse
+  word repeat_int = 0;
+  for (int i = 0; i < my_env->capacity; i++) {
+    // just add 1 in the end of each interval of 000...01
+    repeat_int = repeat_int | my_env->shift_1[i * (sketch_size + 1)];
+  }
+  repeat_int_multiplier = sparse_multiplier(repeat_int);
+
+  // set extract_interposed_bits, which is a bitmask with the positions of the
+  // bits interposed among the repetions of a sequence of bits made with
+  // repeat_int
+  for (int i = 0; i < my_env->capacity; i++) {
+    // just add 1 between in the positions between the repetitions of each
+    // interval
+    extract_interposed_bits =
+        extract_interposed_bits | my_env->shift_1[(i + 1) * sketch_size + i];
+  }
+
+  // the same sketches, one in each lane
+  set_sketch_lanes();
+}
+
+// finds the important bits, m and the variables used in parallel comparison
+// from scratch, after the set of important bits changed
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::build_sketches() {
+  // all the bitmasks below are built with | from zero
+  data = 0;
+  extract_interposed_bits = 0;
+  sketch_mask = 0;
+  sketch_shift = 0;
+  mask_important_bits = 0;
+  important_bits_count = 0;
+
+  // finds the important bits of the elements in the fusion tree,
+  // and saves them in array important_bits, as well as a bitmask of them in
+  // word mask_important_bits, and the number of important bits in
+  // important_bits_count
+  vector<int> important_bits;
+  find_important_bits(important_bits);
+
+  // finds the value of word m, which is used in parallel comparison,
+  // and the value of sketch_mask, the bitmask to extract the important bits
+  // from the sketched integer. Exact sketches do not need them
+  if (!exact_sketches) {
+    find_m(important_bits);
+  }
+
+  // the last thing to be done to initialize a fusion tree
+  set_parallel_comparison();
+}
+
+// moves the sketches in data to make room for a new element in position idx.
+// The sketches of the elements in positions idx and above are in the fields
+// capacity - 1 - idx and below, so they move one field to the right, dropping
+// the first field, which is a missing element. The sketch of x, with its
+// interposed bit, takes the field capacity - 1 - idx
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::insert_in_data(int idx, const word &x) {
+  int field_size = sketch_size + 1;
+  // bitmask of the fields of the elements before position idx, which stay
+  word keep = my_env->shift_neg_0[(my_env->capacity - idx) * field_size];
+
+  data = (data & keep) | ((data & ~keep) >> field_size) |
+         ((my_env->shift_1[sketch_size] | sketch(x))
+          << (my_env->capacity - 1 - idx) * field_size);
+
+  // the lanes after idx move one position to the right, over the lane of a
+  // missing element
+  if (!sketch_lanes.empty()) {
+    for (int i = size() - 1; i > idx; i--) {
+      sketch_lanes[i] = sketch_lanes[i - 1];
+    }
+    sketch_lanes[idx] = lane_sketch(x);
+  }
+}
+
+// moves the sketches in data to remove the element in position idx. The
+// sketches of the elements after position idx move one field to the left, and
+// the first field takes the sketch of a missing element
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::erase_from_data(int idx) {
+  int field_size = sketch_size + 1;
+  // bitmask of the fields of the elements before position idx, which stay
+  word keep = my_env->shift_neg_0[(my_env->capacity - idx) * field_size];
+  // bitmask of the fields of the elements after position idx
+  word after = ~my_env->shift_neg_0[(my_env->capacity - 1 - idx) * field_size];
+
+  data = (data & keep) | ((data & after) << field_size) |
+         (~my_env->shift_neg_0[field_size]);
+
+  // the lanes after idx move one position to the left, and the last one takes
+  // the lane of a missing element
+  if (!sketch_lanes.empty()) {
+    for (int i = idx; i < size(); i++) {
+      sketch_lanes[i] = sketch_lanes[i + 1];
+    }
+    sketch_lanes[size()] = INT64_MAX;
+  }
+}
+
+// returns the approximate sketch, in the fusion tree, of a given number
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::approximate_sketch(
+    const word &x) const {
+  COUNT_SITE(site_approximate_sketch);
+  // extract the important bits of the number, multiply them by m and shift to
+  // the right b_i+m_i positions so that the last significant bit go to position
+  // 0. The product is the only word built, and the mask and the shift after
+  // it are computed in the same pass that builds the sketch
+  word product;
+  m_multiplier.multiply(x & mask_important_bits, product);
+  return (product & sketch_mask) >> sketch_shift;
+}
+
+// returns the exact sketch of a given number, gathering its important bits
+// limb by limb with pext
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::exact_sketch(const word &x) const {
+  COUNT_SITE(site_exact_sketch);
+  // there are less important bits than elements, so the sketch fits in an int
+  return word(int(x.extract_bits(mask_important_bits)));
+}
+
+// returns the sketch of a given number, in the mode chosen when the fusion tree
+// was built
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::sketch(const word &x) const {
+  return exact_sketches ? exact_sketch(x) : approximate_sketch(x);
+}
+
+// returns the sketch of the element in position i. It is in the field
+// capacity - 1 - i of data, right below its interposed bit, so it is read from
+// there instead of sketching the element again
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::stored_sketch(int i) const {
+  return (data >> (my_env->capacity - 1 - i) * (sketch_size + 1)) &
+         (~my_env->shift_neg_0[sketch_size]);
+}
+
+// returns the sketch of a given number as a 64-bit lane. It is only called
+// when the sketches take less than 63 bits, so the sketch is in the lowest limb
+
+template <class word, class env_type>
+const uint64_t basic_fusiontree<word, env_type>::lane_sketch(
+    const word &x) const {
+  return exact_sketches ? x.extract_bits(mask_important_bits)
+                        : approximate_sketch(x).limb(0);
+}
+
+// fills sketch_lanes with the sketches of the elements, in increasing order.
+// The lanes of the missing elements, up to a multiple of LANES, are larger
+// than any sketch, like the missing elements in data. If a sketch may not fit
+// in a lane, the lanes are left empty and data is used
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::set_sketch_lanes() {
+  sketch_lanes.clear();
+  if (lane_count_for(sketch_size) == 0) return;
+  sketch_lanes.assign(lane_count_for(sketch_size), INT64_MAX);
+  for (int i = 0; i < size(); i++) {
+    sketch_lanes[i] = lane_sketch(elements[i]);
+  }
+}
+
+// returns the size of the sketches in data
+// the sketches must also have room for the number of sketches added up in
+// find_sketch_predecessor, which is at most the capacity
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::sketch_size_for(int bits_count,
+                                                            bool exact) const {
+  int res = bits_count;
+  if (!exact) res = bits_count * bits_count * bits_count * bits_count;
+  while (res < 31 and (1 << res) <= my_env->capacity) res++;
+  return res;
+}
+
+// returns the number of lanes for sketches of a size
+// the lanes are rounded up to a multiple of LANES, for the SIMD comparison
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::lane_count_for(
+    int sketch_size_) const {
+  if (sketch_size_ >= 63) return 0;
+  return (my_env->capacity + LANES - 1) / LANES * LANES;
+}
+
+// selects how find_sketch_predecessor compares the sketches
+
+template <class word, class env_type>
+bool basic_fusiontree<word, env_type>::set_search_mode(search_mode mode) {
+  if (mode == simd_search and !cpu_supports_avx2()) return false;
+  search = mode;
+  return true;
+}
+
+// returns the search mode selected
+
+template <class word, class env_type>
+typename basic_fusiontree<word, env_type>::search_mode
+basic_fusiontree<word, env_type>::get_search_mode() const {
+  return search_mode(search);
+}
+
+// returns how the elements are sketched
+
+template <class word, class env_type>
+sketch_mode basic_fusiontree<word, env_type>::get_sketch_mode() const {
+  return exact_sketches ? exact_sketching : approximate_sketching;
+}
+
+// returns an integer with capacity repetitions of a sketch, separated by one
+// zero between any consecutive repetitions
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::multiple_sketches(const word &sketch_x,
+                                                         word &res) const {
+  // multiply the sketch by the variable repeat_int
+  repeat_int_multiplier.multiply(sketch_x, res);
+}
+
+// returns the index of the biggest y in the tree such that
+// sketch(y)<=sketch(x). The sketches in lanes are sorted, and the missing
+// elements are larger than any sketch, so the lanes not greater than sketch(x)
+// are exactly the elements up to the answer
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::find_sketch_predecessor(
+    const word &x) const {
+  COUNT_SITE(site_find_sketch_predecessor);
+  int answer;
+  if (search == word_ram_search or sketch_lanes.empty()) {
+    answer = word_ram_sketch_predecessor(x);
+  } else {
+    uint64_t sketch_x = lane_sketch(x);
+    int n = sketch_lanes.size();
+#if defined(__x86_64__)
+    if (search == simd_search) {
+      answer = count_lanes_not_greater_simd(sketch_lanes.data(), n, sketch_x) -
+               1;
+    } else
+#endif
+      answer =
+          count_lanes_not_greater_scalar(sketch_lanes.data(), n, sketch_x) - 1;
+  }
+  // the answer is a position or -1: the missing elements take the largest
+  // sketch, in data and in the lanes, which check_record also checks for a
+  // fusion tree read from a record
+  return answer;
+}
+
+// returns the index of the biggest y in the tree such that
+// sketch(y)<=sketch(x), using parallel comparison
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::word_ram_sketch_predecessor(
+    const word &x) const {
+  // the sketch of x is calculated once, for the parallel comparison and for the
+  // corner case below
+  word sketch_x = sketch(x);
+
+  // calculate the difference between data and multiple_sketches(sketch_x)
+  // all the interposed bits before sketches greater than sketch(x) will remain
+  // significant. Then extract all the bits interposed among sketches of the
+  // elements in data, in the same pass over the limbs
+  word sum;
+  multiple_sketches(sketch_x, sum);
+  word diff = (data - sum) & extract_interposed_bits;
+  // the number of significant bits is the number of sketches greater then
+  // sketch(x) multiply the extracted bits by repeat_int to make then add up
+  // together before the first interposed bit
+  repeat_int_multiplier.multiply(diff, sum);
+  // shift the result to the right to ignore the trash created after the first
+  // interposed bit, and extract only the the number of bits in a sketch to
+  // ignore trash created before the interval where the extracted bits were
+  // added. The sum is at most capacity, so it is in the lowest bits, which int
+  // keeps, and only the lowest limb of the shift is computed. Only the trash
+  // of a sketch smaller than an int must be masked out
+  int count =
+      (int)(sum >>
+            ((my_env->capacity * sketch_size) + (my_env->capacity - 1))) &
+      ((1 << min(sketch_size, 31)) - 1);
+
+  // the position of sketch(x) can be calculated using the number of sketches in
+  // data and the number of sketches greater than sketh(x), which includes the
+  // capacity - size() missing elements
+  int answer = my_env->capacity - count - 1;
+
+  // check if the corner case in which the sketch is already in the fusion tree,
+  // comparing with the sketch of the element kept in data
+  if (answer + 1 < size() and stored_sketch(answer + 1) == sketch_x) {
+    answer++;
+  }
+  // return the position found
+  return answer;
+}
+
+// copies the elements read in place into an array of the fusion tree
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::own_elements() {
+  if (owns_elements) return;
+  word *copy = new word[my_env->capacity];
+  for (int i = 0; i < size(); i++) {
+    copy[i] = elements[i];
+  }
+  elements = copy;
+  owns_elements = true;
+}
+
+// returns the number of integers stored
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::size() const { return sz; }
+
+// returns the number in a given position in the tree
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::pos(int i) const {
+  return elements[i];
+}
+
+// returns the lowest common ancestor of x with the elements right before and
+// right after its sketch predecessor idx1, or -1, with the index of x in
+// answer, if x is one of them
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::find_lca(const word &x, int idx1,
+                                                     int &answer) const {
+  // indices of sketch predecessor and sucessor
+  int idx2 = idx1 + 1;
+
+  // lowest common ancestor with predecessor and sucessor
+  // it is the same of the longest common prefix, so we can find lca(a,b) by
+  // fiding the first different bit between a and b
+  int lca1, lca2;
+
+  // if the sketch has no predecessor, tag lca1
+  // else calculate the lca between x and its predecessor and keep in lca1
+  if (idx1 < 0) {
+    lca1 = -2;
+  } else {
+    lca1 = my_env->fast_first_diff(elements[idx1], x);
+  }
+
+  // if the sketch has no sucessor, tag lca2
+  // else calculate the lca between x and its sucessore and keep in lca1
+  if (idx2 < size()) {
+    lca2 = my_env->fast_first_diff(elements[idx2], x);
+  } else {
+    lca2 = -2;
+  }
+
+  // if lca1 is negative, then the number is the same as its predecessor
+  // return idx1
+  if (lca1 == -1) {
+    answer = idx1;
+    return -1;
+  }
+  // if lca2 is negative, then the number is the same as its sucessor
+  // return idx2
+  if (lca2 == -1) {
+    answer = idx2;
+    return -1;
+  }
+  int lca;
+
+  // if lca1 is tagged, there is no predecessor, then use lca2, the lca with the
+  // sucessor
+  if (lca1 == -2) lca = lca2;
+  // if lca2 is tagged, there is no sucecessor, then use lca1, the lca with the
+  // predessor
+  if (lca2 == -2) lca = lca1;
+  // if both lca1 and lc2 are tagged, pick the highest lca
+  if (lca1 != -2 and lca2 != -2) lca = min(lca1, lca2);
+
+  return lca;
+}
+
+// returns the integer e whose sketch predecessor leads to the predecessor of x
+
+template <class word, class env_type>
+const word basic_fusiontree<word, env_type>::find_lca_key(const word &x,
+                                                          int lca) const {
+  word e;
+
+  // if the bit that first differentiates x is 1, then x lies in the right
+  // subtree of the lca, therefore, this subtree is empty and the predecessor of
+  // x is the greatest number in the left subtree. Since the sketches keep the
+  // elements order, it is the element with the righmost sketch in that subtree.
+  // If p is the path to the lca, we just need to find the sketch predecessor of
+  // e = p0111...11
+  if ((x & my_env->shift_1[lca]) != word(0)) {
+    // first, add p0 to e, extracting the bits in p from x and adding 0
+    // than add a bunch of 1s, which are the complement of ~0 << lca, in the
+    // same pass
+    e = (x & my_env->shift_neg_1[lca]) | ~my_env->shift_neg_0[lca];
+  }
+
+  // if the bit that first differentiates x is 0, then x lies in the left
+  // subtree of the lca therefore, this subtree is empty and the sucessor of x
+  // is the smallest number in the right subtree. Since the sketches keep the
+  // elements order, it is the element with the leftmost sketch in that subtree.
+  // If p is the path to the lca, we just need to find the sketch predecessor of
+  // e = p1000...00
+  else {
+    // first, add p1 to e, extracting the bits in p from x and adding 1
+    // than add a bunch of 0s, in the same pass
+    e = (x | my_env->shift_1[lca]) & my_env->shift_neg_0[lca];
+  }
+  return e;
+}
+
+// turns the sketch predecessor of the integer returned by find_lca_key into the
+// predecessor of x
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::fix_lca_answer(const word &x,
+                                                           int lca,
+                                                           int answer) const {
+  // if x lies in the left subtree of the lca, the answer is either the sucessor
+  // of x or nothing. If it is the sucessor, just pick the predecessor of the
+  // sucessor which is easy because of array elements
+  if ((x & my_env->shift_1[lca]) == word(0) and answer >= 0 and
+      elements[answer] > x) {
+    answer--;
+  }
+  return answer;
+}
+
+// returns the index of the biggest k in the tree succh that k<=x
+// or -1 if there is no such k
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::find_predecessor(
+    const word &x) const {
+  COUNT_SITE(site_find_predecessor);
+  // an empty fusion tree has no predecessor to find
+  if (size() == 0) return -1;
+
+  // first, find the position of sketch(x) among the sketches of the elements in
+  // the fusion tree keep the element right before and right after sketch(x)
+  int idx1 = find_sketch_predecessor(x);
+
+  // then, find the lowest common ancestor of x with these elements, unless x is
+  // one of them
+  int answer = -1;
+  int lca = find_lca(x, idx1, answer);
+  if (lca < 0) return answer;
+
+  // the answer is found with the sketch predecessor of an integer that has the
+  // path to the lca as its prefix
+  answer = find_sketch_predecessor(find_lca_key(x, lca));
+  return fix_lca_answer(x, lca, answer);
+}
+
+// returns the index of the smallest k in the tree such that k>=x
+// or -1 if there is no such k
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::find_successor(
+    const word &x) const {
+  COUNT_SITE(site_find_successor);
+  // the successor is the first element not smaller than x
+  int answer = rank_of(x);
+  return answer < size() ? answer : -1;
+}
+
+// returns the number of integers in the tree smaller than x. It follows
+// find_predecessor, but it knows whether x is in the tree from the lowest
+// common ancestor, with no comparison of x with the predecessor
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::rank(const word &x) const {
+  COUNT_SITE(site_rank);
+  return rank_of(x);
+}
+
+// rank without a site of its own, so that the queries made of ranks count
+// their operations in their own sites
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::rank_of(const word &x) const {
+  // an empty fusion tree has no element smaller than x
+  if (size() == 0) return 0;
+
+  int idx1 = find_sketch_predecessor(x);
+
+  // if x is in the tree, it is next to its sketch predecessor, and the
+  // elements smaller than it are the ones before its index
+  int answer = -1;
+  int lca = find_lca(x, idx1, answer);
+  if (lca < 0) return answer;
+
+  // otherwise, the elements smaller than x are its predecessor and the ones
+  // before it
+  answer = find_sketch_predecessor(find_lca_key(x, lca));
+  return fix_lca_answer(x, lca, answer) + 1;
+}
+
+// returns the rank of b, given first, the rank of a<b. If the element of rank
+// first is not smaller than b, no element is in [a, b) and b has rank first
+// too, found with one comparison instead of a second rank query
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::range_end(const word &b,
+                                                      int first) const {
+  if (first == size() or !(elements[first] < b)) return first;
+  return rank_of(b);
+}
+
+// returns the number of integers k in the tree such that a<=k<b. The integers
+// in the interval are the ones smaller than b, but not smaller than a, so it
+// takes the ranks of a and b, unless the interval is empty
+
+template <class word, class env_type>
+const int basic_fusiontree<word, env_type>::count_range(const word &a,
+                                                        const word &b) const {
+  COUNT_SITE(site_count_range);
+  if (!(a < b)) return 0;
+  int first = rank_of(a);
+  return range_end(b, first) - first;
+}
+
+// returns the integers k in the tree such that a<=k<b. They are consecutive in
+// array elements, starting at the rank of a
+
+template <class word, class env_type>
+const typename basic_fusiontree<word, env_type>::range
+basic_fusiontree<word, env_type>::find_range(
+    const word &a, const word &b) const {
+  COUNT_SITE(site_find_range);
+  int first = rank_of(a);
+  range answer;
+  answer.first = elements + first;
+  answer.last = elements + (a < b ? range_end(b, first) : first);
+  return answer;
+}
+
+// returns an iterator to the first element
+
+template <class word, class env_type>
+typename basic_fusiontree<word, env_type>::const_iterator
+basic_fusiontree<word, env_type>::begin() const {
+  return elements;
+}
+
+// returns an iterator to the position after the last element
+
+template <class word, class env_type>
+typename basic_fusiontree<word, env_type>::const_iterator
+basic_fusiontree<word, env_type>::end() const {
+  return elements + sz;
+}
+
+// finds the predecessor of each of the n integers in queries. The queries are
+// processed in blocks of batch_block, and each stage of find_predecessor is
+// done for every query of the block before the next stage starts. The stages
+// of a single query depend on each other, but the same stage of different
+// queries do not, so they can overlap in the processor
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::find_predecessor_batch(
+    const word *queries, int n, int *out) const {
+  COUNT_SITE(site_find_predecessor);
+  // an empty fusion tree has no predecessor to find
+  if (size() == 0) {
+    for (int i = 0; i < n; i++) out[i] = -1;
+    return;
+  }
+
+  // lowest common ancestor of each query of the block, or -1 if it is already
+  // answered, and the integers whose sketch predecessor are the answers. They
+  // are reused by all the blocks
+  int lca[batch_block];
+  word e[batch_block];
+
+  for (int begin = 0; begin < n; begin += batch_block) {
+    int count = min(n - begin, int(batch_block));
+    const word *x = queries + begin;
+    int *answer = out + begin;
+
+    // sketch predecessors of the queries
+    for (int i = 0; i < count; i++) {
+      answer[i] = find_sketch_predecessor(x[i]);
+    }
+
+    // lowest common ancestors with the elements next to them
+    for (int i = 0; i < count; i++) {
+      lca[i] = find_lca(x[i], answer[i], answer[i]);
+    }
+
+    // integers with the path to the lca as their prefixes
+    for (int i = 0; i < count; i++) {
+      if (lca[i] >= 0) e[i] = find_lca_key(x[i], lca[i]);
+    }
+
+    // their sketch predecessors, fixed into the predecessors of the queries
+    for (int i = 0; i < count; i++) {
+      if (lca[i] >= 0) {
+        answer[i] = fix_lca_answer(x[i], lca[i], find_sketch_predecessor(e[i]));
+      }
+    }
+  }
+}
+
+// inserts x in the fusion tree. If the set of important bits does not change,
+// the sketches of the elements stay the same and only data has to be updated.
+// Otherwise, the sketches are built again
+
+template <class word, class env_type>
+bool basic_fusiontree<word, env_type>::insert(const word &x) {
+  COUNT_SITE(site_insert);
+  // there is no room for x
+  if (size() == my_env->capacity) return false;
+
+  // find the position of x in the fusion tree
+  int idx = find_predecessor(x);
+  // x is already in the fusion tree
+  if (idx >= 0 and elements[idx] == x) return false;
+  idx++;
+  own_elements();
+
+  // the important bits are the first different bits between consecutive
+  // elements. Between x and its neighbors there are two of them, and the
+  // highest is the one that was between the neighbors before, so only the
+  // lowest may be new
+  int new_bit = -1;
+  if (idx > 0) {
+    new_bit = my_env->fast_first_diff(elements[idx - 1], x);
+  }
+  if (idx < size()) {
+    int diff_point = my_env->fast_first_diff(x, elements[idx]);
+    if (new_bit < 0 or diff_point < new_bit) new_bit = diff_point;
+  }
+
+  // make room for x in array elements
+  for (int i = size(); i > idx; i--) {
+    elements[i] = elements[i - 1];
+  }
+  elements[idx] = x;
+  sz++;
+
+  // the first element rebuilds the sketches, which may be left over from
+  // the elements of a moved-from fusion tree
+  if (size() == 1 or
+      (new_bit >= 0 and
+       (mask_important_bits & my_env->shift_1[new_bit]) == word(0))) {
+    build_sketches();
+  } else {
+    insert_in_data(idx, x);
+  }
+  return true;
+}
+
+// removes x from the fusion tree. If the set of important bits does not
+// change, only data has to be updated. Otherwise, the sketches are built again
+
+template <class word, class env_type>
+bool basic_fusiontree<word, env_type>::erase(const word &x) {
+  COUNT_SITE(site_erase);
+  // find the position of x in the fusion tree
+  int idx = find_predecessor(x);
+  // x is not in the fusion tree
+  if (idx < 0 or elements[idx] != x) return false;
+  own_elements();
+
+  // the first different bits between x and its neighbors are not between
+  // consecutive elements anymore, but the highest of them is the one between
+  // the neighbors. So only the lowest may stop being an important bit
+  int old_bit = -1;
+  if (idx > 0) {
+    old_bit = my_env->fast_first_diff(elements[idx - 1], x);
+  }
+  if (idx + 1 < size()) {
+    int diff_point = my_env->fast_first_diff(x, elements[idx + 1]);
+    if (old_bit < 0 or diff_point < old_bit) old_bit = diff_point;
+  }
+
+  // remove x from array elements
+  for (int i = idx; i + 1 < size(); i++) {
+    elements[i] = elements[i + 1];
+  }
+  sz--;
+
+  // old_bit is still important if it is the first different bit between other
+  // consecutive elements
+  bool still_important = (old_bit < 0);
+  for (int i = 0; i + 1 < size() and !still_important; i++) {
+    if (my_env->fast_first_diff(elements[i], elements[i + 1]) == old_bit) {
+      still_important = true;
+    }
+  }
+
+  if (still_important) {
+    erase_from_data(idx);
+  } else {
+    build_sketches();
+  }
+  return true;
+}
+
+// returns the number of bytes of the node record, see fusion_file.hpp
+
+template <class word, class env_type>
+size_t basic_fusiontree<word, env_type>::serialized_size() const {
+  int m_count = exact_sketches ? 0 : m_multiplier.positions().size();
+  return sizeof(fusion_node_header) + (5 + size()) * sizeof(word) +
+         (important_bits_count + m_count + sketch_lanes.size()) *
+             sizeof(uint64_t);
+}
+
+// writes the node record. The words are copied limb by limb, since a word is
+// an array of 64-bit limbs
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::serialize(char *out) const {
+  const vector<int> &m_indices = m_multiplier.positions();
+  int m_count = exact_sketches ? 0 : m_indices.size();
+
+  fusion_node_header *header = (fusion_node_header *)out;
+  header->record_size = serialized_size();
+  header->size = size();
+  header->important_bits_count = important_bits_count;
+  header->m_count = m_count;
+  header->sketch_size = sketch_size;
+  header->sketch_shift = sketch_shift;
+  header->exact_sketches = exact_sketches;
+  header->lane_count = sketch_lanes.size();
+  out += sizeof(fusion_node_header);
+
+  // m is only kept as the positions of its set bits
+  word m = 0;
+  for (int i = 0; i < m_count; i++) {
+    m.set_bit(m_indices[i]);
+  }
+  const word *masks[5] = {&data, &extract_interposed_bits, &sketch_mask,
+                          &mask_important_bits, &m};
+  for (int i = 0; i < 5; i++) {
+    memcpy(out, masks[i], sizeof(word));
+    out += sizeof(word);
+  }
+
+  uint64_t *indices = (uint64_t *)out;
+  for (int i = mask_important_bits.next_set_bit(0); i >= 0;
+       i = mask_important_bits.next_set_bit(i + 1)) {
+    *indices++ = i;
+  }
+  for (int i = 0; i < m_count; i++) {
+    *indices++ = m_indices[i];
+  }
+  for (int i = 0; i < (int)sketch_lanes.size(); i++) {
+    *indices++ = sketch_lanes[i];
+  }
+  out = (char *)indices;
+
+  memcpy(out, elements, size() * sizeof(word));
+}
+
+// writes the fusion tree to a file, after a file header
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::save(const char *path) const {
+  size_t file_size = sizeof(fusion_file_header) + serialized_size();
+  vector<uint64_t> image(file_size / sizeof(uint64_t));
+
+  *(fusion_file_header *)image.data() =
+      make_fusion_file_header(fusion_file_node, word::bits,
+                              my_env->element_size, my_env->capacity,
+                              file_size);
+  serialize((char *)image.data() + sizeof(fusion_file_header));
+  write_fusion_file(path, image);
+}
+
+// fusiontree constructor over a node record
+// the words of the record are copied into the masks, and the multipliers are
+// made from the positions of their set bits. Nothing is built again
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(const char *record,
+                                                   const env_type *my_env_) {
+  my_env = my_env_;
+
+  // the fields of the header are checked before any of them is used. A node
+  // of size n has at most n - 1 important bits, and the size of the sketches,
+  // the number of set bits of m and the number of lanes follow from them
+  const fusion_node_header *header = (const fusion_node_header *)record;
+  int capacity = my_env->capacity;
+  if (header->size > (uint64_t)capacity or
+      header->important_bits_count >= (uint64_t)max(capacity, 1) or
+      header->exact_sketches > 1) {
+    throw(string("corrupt fusion tree record"));
+  }
+  sz = header->size;
+  important_bits_count = header->important_bits_count;
+  exact_sketches = header->exact_sketches;
+  sketch_size = sketch_size_for(important_bits_count, exact_sketches);
+  int m_count = exact_sketches ? 0 : important_bits_count;
+  int lane_count = lane_count_for(sketch_size);
+
+  if ((sz == 0 ? important_bits_count != 0
+               : important_bits_count > sz - 1) or
+      header->sketch_size != (uint64_t)sketch_size or
+      (long long)capacity * (sketch_size + 1) > word::bits or
+      header->sketch_shift >= (uint64_t)word::bits or
+      header->m_count != (uint64_t)m_count or
+      header->lane_count != (uint64_t)lane_count or
+      header->record_size !=
+          sizeof(fusion_node_header) + (5 + sz) * sizeof(word) +
+              (important_bits_count + m_count + lane_count) *
+                  sizeof(uint64_t)) {
+    throw(string("corrupt fusion tree record"));
+  }
+  sketch_shift = header->sketch_shift;
+  record += sizeof(fusion_node_header);
+
+  // view checks that the masks have no bits set above the size of the word
+  word m;
+  word *masks[5] = {&data, &extract_interposed_bits, &sketch_mask,
+                    &mask_important_bits, &m};
+  const word *record_masks = word::view((const uint64_t *)record, 5);
+  for (int i = 0; i < 5; i++) {
+    *masks[i] = record_masks[i];
+    record += sizeof(word);
+  }
+  // the indices of the important bits and of the set bits of m are kept for
+  // the readers of the file, but the masks already have them
+  const uint64_t *indices = (const uint64_t *)record;
+  record += (important_bits_count + m_count) * sizeof(uint64_t);
+
+  // the lanes of the missing elements must keep the largest sketch, so that
+  // no search returns a position beyond the size
+  const uint64_t *lanes = (const uint64_t *)record;
+  for (int i = sz; i < lane_count; i++) {
+    if (lanes[i] != INT64_MAX) throw(string("corrupt fusion tree record"));
+  }
+  sketch_lanes.assign(lanes, lanes + lane_count);
+  record += lane_count * sizeof(uint64_t);
+
+  // a word is an array of limbs, so the elements are read as words in place.
+  // They must be in increasing order
+  elements = (word *)word::view((const uint64_t *)record, sz);
+  owns_elements = false;
+  for (int i = 1; i < sz; i++) {
+    if (!(elements[i - 1] < elements[i])) {
+      throw(string("corrupt fusion tree record"));
+    }
+  }
+
+  if (!exact_sketches) m_multiplier = sparse_multiplier(m);
+  check_record(indices, m);
+
+  word repeat_int = 0;
+  for (int i = 0; i < my_env->capacity; i++) {
+    repeat_int.set_bit(i * (sketch_size + 1));
+  }
+  repeat_int_multiplier = sparse_multiplier(repeat_int);
+
+  search = cpu_supports_avx2() ? simd_search : lane_search;
+}
+
+// checks the words read from a node record against its elements. The
+// important bits must be the first different bits between consecutive
+// elements, and m and sketch_mask must take them into the bits of a sketch,
+// keeping their order. Then data and the lanes must keep the sketches of the
+// elements, which must increase. So every query of the fusion tree behaves as
+// in a fusion tree built from the elements. It takes O(size) first different
+// bits and sketches, and O(important_bits_count^2) sums for m, but not the
+// search of find_m
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::check_record(const uint64_t *indices,
+                                                    const word &m) const {
+  const string corrupt = "corrupt fusion tree record";
+  if (size() > 0 and elements[size() - 1].most_significant_bit() >=
+                         my_env->element_size) {
+    throw(corrupt);
+  }
+
+  word important_bits = 0;
+  for (int i = 1; i < size(); i++) {
+    important_bits.set_bit(
+        my_env->fast_first_diff(elements[i - 1], elements[i]));
+  }
+  if (important_bits != mask_important_bits) throw(corrupt);
+  int k = 0;
+  for (int i = important_bits.next_set_bit(0); i >= 0;
+       i = important_bits.next_set_bit(i + 1), k++) {
+    if (k >= important_bits_count or indices[k] != (uint64_t)i) throw(corrupt);
+  }
+  if (k != important_bits_count) throw(corrupt);
+
+  // exact sketches do not use m, sketch_mask or sketch_shift, which are
+  // written as zero
+  if (exact_sketches) {
+    if (m != word(0) or sketch_mask != word(0) or sketch_shift != 0) {
+      throw(corrupt);
+    }
+  }
+
+  // m has a set bit m_i for each important bit b_i. The sketch of any integer
+  // keeps the order of the important bits only if every sum b_i+m_j is
+  // distinct, so that the product by m has no carries, if the sums b_i+m_i
+  // increase with i, and if sketch_mask has exactly these sums, in a sketch
+  // starting at sketch_shift. Then every sketch is smaller than
+  // 2^sketch_size, as the sketches built by find_m are
+  if (!exact_sketches) {
+    vector<int> m_indices;
+    for (int i = m.next_set_bit(0); i >= 0; i = m.next_set_bit(i + 1)) {
+      if ((int)m_indices.size() >= important_bits_count or
+          indices[important_bits_count + m_indices.size()] != (uint64_t)i) {
+        throw(corrupt);
+      }
+      m_indices.push_back(i);
+    }
+    if ((int)m_indices.size() != important_bits_count) throw(corrupt);
+
+    vector<int> sums;
+    word expected_mask = 0;
+    for (int i = 0; i < important_bits_count; i++) {
+      for (int j = 0; j < important_bits_count; j++) {
+        sums.push_back(indices[i] + m_indices[j]);
+      }
+      int sum = indices[i] + m_indices[i];
+      if (sum >= word::bits or
+          (i > 0 and sum <= (int)indices[i - 1] + m_indices[i - 1])) {
+        throw(corrupt);
+      }
+      expected_mask.set_bit(sum);
+    }
+    sort(sums.begin(), sums.end());
+    if (adjacent_find(sums.begin(), sums.end()) != sums.end()) throw(corrupt);
+    if (expected_mask != sketch_mask) throw(corrupt);
+    if (important_bits_count == 0 ? sketch_shift != 0
+                                  : sketch_shift != (int)indices[0] +
+                                                        m_indices[0]) {
+      throw(corrupt);
+    }
+    if (sketch_mask.most_significant_bit() >= sketch_shift + sketch_size) {
+      throw(corrupt);
+    }
+  }
+
+  // data is rebuilt from the sketches as in set_parallel_comparison
+  int capacity = my_env->capacity;
+  word interposed_bits = 0, expected_data = 0;
+  for (int i = 0; i < capacity; i++) {
+    interposed_bits.set_bit((i + 1) * sketch_size + i);
+  }
+  if (interposed_bits != extract_interposed_bits) throw(corrupt);
+
+  vector<word> sketches(size());
+  for (int i = 0; i < size(); i++) {
+    sketches[i] = sketch(elements[i]);
+    if (i > 0 and !(sketches[i - 1] < sketches[i])) throw(corrupt);
+    if (!sketch_lanes.empty() and sketch_lanes[i] != sketches[i].limb(0)) {
+      throw(corrupt);
+    }
+  }
+  for (int i = 0; i < capacity; i++) {
+    int idx = capacity - 1 - i;
+    word field = idx < size() ? sketches[idx]
+                              : word(~my_env->shift_neg_0[sketch_size]);
+    expected_data = expected_data | (field << i * (sketch_size + 1));
+  }
+  if ((expected_data | interposed_bits) != data) throw(corrupt);
+}
+
+// fusiontree constructor over a mapped file
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(const mapped_file &file_,
+                                                   const env_type *my_env_)
+    : basic_fusiontree(
+          file_.node_record(file_.contents(fusion_file_node, word::bits,
+                                           my_env_->element_size,
+                                           my_env_->capacity) -
+                            file_.data()),
+          my_env_) {}
+
+// fusiontree constructor
+// v_ is a vector with the integers to be stored
+// my_env is the environment with the specifications of the fusion tree
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(vector<word> &elements_,
+                                                   const env_type *my_env_) {
+  // set the values of the class variables
+  // see class fusiontree in the header file for comments on each variable
+
+  my_env = my_env_;  // keeps a pointer to the environment *my_env_
+
+  // creates the array of elements, allocating dynamically because variable
+  // lenght arrays are forbidden as class members. It has room for capacity
+  // elements, so that insert does not need to allocate
+  elements = new word[my_env->capacity];
+  owns_elements = true;
+
+  // adds the elements of the array elements_, passed as a reference in the
+  // first argument in the array elements, which is a class member, and keeps
+  // the elements in the fusion tree
+  add_in_array(elements_);
+
+  // the sketches are the ones asked by the environment. If it leaves the
+  // choice, the important bits are gathered exactly with pext if the processor
+  // supports it. Otherwise, approximate sketches are used
+  exact_sketches =
+      my_env->sketching == exact_sketching or
+      (my_env->sketching == auto_sketching and cpu_supports_bmi2());
+
+  // the sketches are compared with AVX2 if the processor supports it
+  search = cpu_supports_avx2() ? simd_search : lane_search;
+
+  // finds the important bits, m, and the variables used in parallel comparison
+  build_sketches();
+}
+
+// fusiontree constructor that shares the ownership of the environment
+// the fusion tree keeps a copy of the shared pointer, so the environment is
+// freed only after the last fusion tree over it
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(
+    vector<word> &elements_, shared_ptr<const env_type> my_env_)
+    : basic_fusiontree(elements_, my_env_.get()) {
+  env_owner = my_env_;
+}
+
+// fusiontree copy constructor
+// copies every member and gives the copy its own array of elements
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(const basic_fusiontree &t)
+    : my_env(t.my_env),
+      env_owner(t.env_owner),
+      data(t.data),
+      sz(t.sz),
+      extract_interposed_bits(t.extract_interposed_bits),
+      repeat_int_multiplier(t.repeat_int_multiplier),
+      sketch_mask(t.sketch_mask),
+      m_multiplier(t.m_multiplier),
+      sketch_shift(t.sketch_shift),
+      important_bits_count(t.important_bits_count),
+      mask_important_bits(t.mask_important_bits),
+      exact_sketches(t.exact_sketches),
+      sketch_size(t.sketch_size),
+      sketch_lanes(t.sketch_lanes),
+      search(t.search) {
+  elements = new word[my_env->capacity];
+  owns_elements = true;
+  for (int i = 0; i < sz; i++) {
+    elements[i] = t.elements[i];
+  }
+}
+
+// fusiontree move constructor
+// takes the array of elements and the multipliers of t, and copies the masks,
+// which are kept inside the fusion tree. t is left empty, with no array
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::basic_fusiontree(
+    basic_fusiontree &&t) noexcept
+    : my_env(t.my_env),
+      env_owner(t.env_owner),
+      data(t.data),
+      elements(t.elements),
+      sz(t.sz),
+      owns_elements(t.owns_elements),
+      extract_interposed_bits(t.extract_interposed_bits),
+      repeat_int_multiplier(std::move(t.repeat_int_multiplier)),
+      sketch_mask(t.sketch_mask),
+      m_multiplier(std::move(t.m_multiplier)),
+      sketch_shift(t.sketch_shift),
+      important_bits_count(t.important_bits_count),
+      mask_important_bits(t.mask_important_bits),
+      exact_sketches(t.exact_sketches),
+      sketch_size(t.sketch_size),
+      sketch_lanes(std::move(t.sketch_lanes)),
+      search(t.search) {
+  // t keeps a share of the environment, and no array of elements: its first
+  // insert allocates one, and rebuilds the sketches it lost
+  t.elements = NULL;
+  t.owns_elements = false;
+  t.sz = 0;
+}
+
+// fusiontree assignment
+// t is already a copy, or the moved fusion tree, so it only has to be swapped
+// with *this, and the old contents are freed with t
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type> &basic_fusiontree<word, env_type>::operator=(
+    basic_fusiontree t) noexcept {
+  swap(t);
+  return *this;
+}
+
+// exchanges the contents of two fusion trees
+
+template <class word, class env_type>
+void basic_fusiontree<word, env_type>::swap(basic_fusiontree &t) noexcept {
+  std::swap(my_env, t.my_env);
+  env_owner.swap(t.env_owner);
+  std::swap(data, t.data);
+  std::swap(elements, t.elements);
+  std::swap(sz, t.sz);
+  std::swap(owns_elements, t.owns_elements);
+  std::swap(extract_interposed_bits, t.extract_interposed_bits);
+  std::swap(repeat_int_multiplier, t.repeat_int_multiplier);
+  std::swap(sketch_mask, t.sketch_mask);
+  std::swap(m_multiplier, t.m_multiplier);
+  std::swap(sketch_shift, t.sketch_shift);
+  std::swap(important_bits_count, t.important_bits_count);
+  std::swap(mask_important_bits, t.mask_important_bits);
+  std::swap(exact_sketches, t.exact_sketches);
+  std::swap(sketch_size, t.sketch_size);
+  sketch_lanes.swap(t.sketch_lanes);
+  std::swap(search, t.search);
+}
+
+// fusiontree destructor
+// It just needs to free the dynamically allocated arrays in the class
+
+template <class word, class env_type>
+basic_fusiontree<word, env_type>::~basic_fusiontree() {
+  // use delete [] to free an array. The elements read in place belong to the
+  // record
+  if (owns_elements) delete[] elements;
+}
+
 // prints all the numbers, in binary form, in a fusion tree
-std::ostream &operator<<(std::ostream &out, const fusiontree &t);
+template <class word, class env_type>
+ostream &operator<<(ostream &out, const basic_fusiontree<word, env_type> &t) {
+  for (int i = 0; i < t.size(); i++) {
+    out << t.pos(i) << endl;
+  }
+
+  return out;
+}
+
+// the environment and fusion tree over the default big_int are compiled once,
+// in fusiontree.cpp
+extern template class basic_environment<big_int>;
+extern template class basic_fusiontree<big_int>;
 
 #endif /* fusiontree_hpp */
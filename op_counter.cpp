@@ -0,0 +1,177 @@
+//
+//  op_counter.cpp
+//  Fusion Tree
+//
+
+#include "op_counter.hpp"
+
+#include <mutex>
+#include <vector>
+
+// counters of every thread that counted. They are never freed, so that the
+// counts of finished threads stay in the total
+static mutex threads_lock;
+static vector<op_thread_counters *> threads;
+
+thread_local op_thread_counters *op_counter::local = NULL;
+
+static const char *kind_names[op_kind_count] = {"mul", "add", "shift",
+                                                "logic", "compare"};
+
+static const char *site_names[op_site_count] = {
+    "other",
+    "find_predecessor",
+    "find_successor",
+    "rank",
+    "count_range",
+    "find_range",
+    "find_sketch_predecessor",
+    "approximate_sketch",
+    "exact_sketch",
+    "most_significant_bit",
+    "first_diff",
+    "find_important_bits",
+    "find_m",
+    "set_parallel_comparison",
+    "insert",
+    "erase"};
+
+const char *op_kind_name(int kind) { return kind_names[kind]; }
+
+const char *op_site_name(int site) { return site_names[site]; }
+
+op_counts::op_counts() {
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) count[i][j] = 0;
+  }
+}
+
+uint64_t op_counts::total() const {
+  uint64_t res = 0;
+  for (int i = 0; i < op_site_count; i++) res += site_total(op_site(i));
+  return res;
+}
+
+uint64_t op_counts::site_total(op_site site) const {
+  uint64_t res = 0;
+  for (int j = 0; j < op_kind_count; j++) res += count[site][j];
+  return res;
+}
+
+uint64_t op_counts::kind_total(op_kind kind) const {
+  uint64_t res = 0;
+  for (int i = 0; i < op_site_count; i++) res += count[i][kind];
+  return res;
+}
+
+op_counts op_counts::operator-(const op_counts &x) const {
+  op_counts res;
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) {
+      res.count[i][j] = count[i][j] - x.count[i][j];
+    }
+  }
+  return res;
+}
+
+op_counts &op_counts::operator+=(const op_counts &x) {
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) count[i][j] += x.count[i][j];
+  }
+  return *this;
+}
+
+// one line for each site with some operation, and a line with the totals
+
+void op_counts::print(ostream &out) const {
+  for (int i = 0; i < op_site_count; i++) {
+    if (site_total(op_site(i)) == 0) continue;
+    out << site_names[i] << ":";
+    for (int j = 0; j < op_kind_count; j++) {
+      out << " " << kind_names[j] << "=" << count[i][j];
+    }
+    out << endl;
+  }
+  out << "total:";
+  for (int j = 0; j < op_kind_count; j++) {
+    out << " " << kind_names[j] << "=" << kind_total(op_kind(j));
+  }
+  out << endl;
+}
+
+// an object with an object of counts for each site with some operation
+
+void op_counts::print_json(ostream &out) const {
+  out << "{";
+  bool first = true;
+  for (int i = 0; i < op_site_count; i++) {
+    if (site_total(op_site(i)) == 0) continue;
+    out << (first ? "" : ", ") << "\"" << site_names[i] << "\": {";
+    for (int j = 0; j < op_kind_count; j++) {
+      out << (j == 0 ? "" : ", ") << "\"" << kind_names[j]
+          << "\": " << count[i][j];
+    }
+    out << "}";
+    first = false;
+  }
+  out << "}" << endl;
+}
+
+// creates the counters of the calling thread
+
+op_thread_counters *op_counter::register_thread() {
+  op_thread_counters *c = new op_thread_counters;
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) c->count[i][j] = 0;
+  }
+  c->site = site_other;
+
+  lock_guard<mutex> guard(threads_lock);
+  threads.push_back(c);
+  local = c;
+  return c;
+}
+
+op_site op_counter::enter(op_site site) {
+  op_thread_counters *c = local != NULL ? local : register_thread();
+  op_site previous = c->site;
+  c->site = site;
+  return previous;
+}
+
+// reads the counters of a thread, which may be counting meanwhile
+
+static op_counts read_counters(const op_thread_counters *c) {
+  op_counts res;
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) {
+      res.count[i][j] = c->count[i][j].load(memory_order_relaxed);
+    }
+  }
+  return res;
+}
+
+op_counts op_counter::thread_counts() {
+  if (local == NULL) return op_counts();
+  return read_counters(local);
+}
+
+op_counts op_counter::total() {
+  lock_guard<mutex> guard(threads_lock);
+  op_counts res;
+  for (int t = 0; t < (int)threads.size(); t++) {
+    res += read_counters(threads[t]);
+  }
+  return res;
+}
+
+void op_counter::reset() {
+  lock_guard<mutex> guard(threads_lock);
+  for (int t = 0; t < (int)threads.size(); t++) {
+    for (int i = 0; i < op_site_count; i++) {
+      for (int j = 0; j < op_kind_count; j++) {
+        threads[t]->count[i][j].store(0, memory_order_relaxed);
+      }
+    }
+  }
+}
@@ -0,0 +1,144 @@
+//
+//  op_counter.hpp
+//  Fusion Tree
+//
+
+#ifndef op_counter_hpp
+#define op_counter_hpp
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+
+// counters of the operations of basic_big_int, by kind and by the function of
+// the fusion tree that made them. A fusion tree query should make a constant
+// number of them, whatever the size of the word. The operators only count
+// when the program is built with COUNT_OPS=1 ("make COUNT_OPS=1"). Otherwise
+// COUNT_OP and COUNT_SITE expand to nothing, and every count stays zero
+
+// kinds of operations
+enum op_kind {
+  op_mul,      // multiplications, including the ones by a sparse_multiplier
+  op_add,      // additions, subtractions and negations
+  op_shift,    // shifts in either direction
+  op_logic,    // and, or, xor, not, the bit scans, setting a bit and pext
+  op_compare,  // comparisons
+  op_kind_count
+};
+
+// functions to which the operations are attributed. An operation is
+// attributed to the innermost of them being run in its thread, or to
+// site_other outside all of them
+enum op_site {
+  site_other,
+  site_find_predecessor,         // find_predecessor and
+                                 // find_predecessor_batch, except the stages
+                                 // below, as the other queries
+  site_find_successor,
+  site_rank,
+  site_count_range,
+  site_find_range,
+  site_find_sketch_predecessor,  // parallel comparison of the sketches
+  site_approximate_sketch,       // multiplication by m
+  site_exact_sketch,             // pext of the important bits
+  site_most_significant_bit,     // fast_most_significant_bit
+  site_first_diff,               // fast_first_diff
+  site_find_important_bits,      // construction of a node
+  site_find_m,
+  site_set_parallel_comparison,
+  site_insert,  // insert and erase, outside the stages above
+  site_erase,
+  op_site_count
+};
+
+// returns the name of a kind of operation, or of a site
+const char *op_kind_name(int kind);
+const char *op_site_name(int site);
+
+// number of operations of each kind made at each site
+struct op_counts {
+  uint64_t count[op_site_count][op_kind_count];
+
+  // all the counts are zero
+  op_counts();
+
+  // returns the number of operations of all kinds at all sites, of all kinds
+  // at a site, and of a kind at all sites
+  uint64_t total() const;
+  uint64_t site_total(op_site site) const;
+  uint64_t kind_total(op_kind kind) const;
+
+  // the counts made between two snapshots, as the ones of a single query, are
+  // the difference between them
+  op_counts operator-(const op_counts &x) const;
+  op_counts &operator+=(const op_counts &x);
+
+  // writes the nonzero counts as text, one site in each line, or as a JSON
+  // object with an object of counts for each site
+  void print(ostream &out) const;
+  void print_json(ostream &out) const;
+};
+
+// counts of the threads. Each thread counts in its own counters, which are
+// only written by it, so counting needs no atomic operation
+struct op_thread_counters {
+  atomic<uint64_t> count[op_site_count][op_kind_count];
+  op_site site;  // site being run by the thread
+};
+
+class op_counter {
+ private:
+  // counters of the calling thread, created at its first operation
+  static thread_local op_thread_counters *local;
+
+  // creates and keeps the counters of the calling thread
+  static op_thread_counters *register_thread();
+
+ public:
+  // counts an operation of the given kind at the current site of the thread
+  static void count(op_kind kind) {
+    op_thread_counters *c = local != NULL ? local : register_thread();
+    atomic<uint64_t> &counter = c->count[c->site][kind];
+    counter.store(counter.load(memory_order_relaxed) + 1,
+                  memory_order_relaxed);
+  }
+
+  // changes the site of the calling thread and returns the previous one
+  static op_site enter(op_site site);
+
+  // returns the counts of the calling thread since it started. The counts of a
+  // query are the difference of the counts after and before it
+  static op_counts thread_counts();
+
+  // returns the sum of the counts of all the threads that ever counted,
+  // including the ones that have finished
+  static op_counts total();
+
+  // sets the counts of every thread to zero. No other thread may count
+  // meanwhile
+  static void reset();
+};
+
+// attributes the operations of the calling thread to a site while it exists,
+// and to the previous site after it
+class op_scope {
+ private:
+  op_site previous;
+
+ public:
+  explicit op_scope(op_site site) : previous(op_counter::enter(site)) {}
+  ~op_scope() { op_counter::enter(previous); }
+};
+
+#if COUNT_OPS
+#define COUNT_OP(kind) op_counter::count(kind)
+#define COUNT_SITE(site) op_scope op_scope_guard(site)
+#else
+#define COUNT_OP(kind)
+#define COUNT_SITE(site)
+#endif
+
+#endif /* op_counter_hpp */
@@ -0,0 +1,10 @@
+//
+//  query_pool.cpp
+//  Fusion Tree
+//
+
+#include "query_pool.hpp"
+
+// compiles the pool over the B-tree of the default big_int, so that programs
+// using it do not need to instantiate it again
+template class basic_query_pool<fusion_btree, big_int>;
@@ -0,0 +1,95 @@
+//
+//  query_pool.hpp
+//  Fusion Tree
+//
+
+#ifndef query_pool_hpp
+#define query_pool_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+// pool of threads that answer predecessor queries over the same tree at once.
+// The queries only read the tree and its environment, so the threads share
+// them without any locking. A job is split in blocks of block_size queries,
+// and each thread of a thread_pool takes the next free block from an atomic
+// counter until none is left, so faster threads take more blocks. Each block
+// is answered with find_predecessor_batch. tree_type is any tree with that
+// method, like basic_fusiontree or basic_fusion_btree over words of type
+// word. The tree must not be changed while a job runs
+template <class tree_type, class word>
+class basic_query_pool {
+ private:
+  // number of queries each thread takes at a time. Large enough that taking a
+  // block costs little next to answering it, small enough to balance the load
+  static const int block_size = 256;
+
+  const tree_type *tree;  // tree queried by the threads
+  thread_pool workers;    // threads that answer the blocks
+
+  // a pool owns its threads, so it cannot be copied
+  basic_query_pool(const basic_query_pool &);
+  basic_query_pool &operator=(const basic_query_pool &);
+
+ public:
+  // number of threads in the pool
+  const int size() const;
+
+  // sets out[i] to the index of the predecessor of queries[i] in the tree,
+  // for 0<=i<n, as find_predecessor does. Blocks until all answers are ready
+  void find_predecessor(const word *queries_, int n_, int *out_);
+
+  // pool constructor
+  // starts threads_ threads over tree_, or one per hardware thread if threads_
+  // is 0. The tree must outlive the pool
+  basic_query_pool(const tree_type &tree_, int threads_ = 0);
+};
+
+// the pool over the B-tree of the default big_int
+typedef basic_query_pool<fusion_btree, big_int> query_pool;
+
+// returns the number of threads in the pool
+
+template <class tree_type, class word>
+const int basic_query_pool<tree_type, word>::size() const {
+  return workers.size();
+}
+
+// answers n_ predecessor queries with all the threads of the pool. The job
+// lives in this call, which blocks until every thread is done with it
+
+template <class tree_type, class word>
+void basic_query_pool<tree_type, word>::find_predecessor(const word *queries_,
+                                                         int n_, int *out_) {
+  if (n_ <= 0) return;
+
+  atomic<int> next_block(0);  // first query of the next free block
+  workers.run([&](int) {
+    while (true) {
+      int first = next_block.fetch_add(block_size);
+      if (first >= n_) break;
+      int count = min(int(block_size), n_ - first);
+      tree->find_predecessor_batch(queries_ + first, count, out_ + first);
+    }
+  });
+}
+
+// pool constructor
+
+template <class tree_type, class word>
+basic_query_pool<tree_type, word>::basic_query_pool(const tree_type &tree_,
+                                                    int threads_)
+    : tree(&tree_), workers(threads_) {}
+
+// the pool over the B-tree of the default big_int is compiled once, in
+// query_pool.cpp
+extern template class basic_query_pool<fusion_btree, big_int>;
+
+#endif /* query_pool_hpp */
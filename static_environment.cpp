@@ -0,0 +1,11 @@
+//
+//  static_environment.cpp
+//  Fusion Tree
+//
+
+#include "static_environment.hpp"
+
+// compiles the static environment with the default parameters of environment,
+// and the fusion tree over it
+template class static_environment<WSIZE, 3136, 5>;
+template class basic_fusiontree<big_int, static_environment<WSIZE, 3136, 5> >;
@@ -0,0 +1,170 @@
+//
+//  static_environment.hpp
+//  Fusion Tree
+//
+
+#ifndef static_environment_hpp
+#define static_environment_hpp
+
+#include <stdio.h>
+
+#include "big_int.hpp"
+#include "fusiontree.hpp"
+
+using namespace std;
+
+// returns the square root of n, rounded down, trying every r from the given
+// one. It is evaluated at compile time to check the parameters of a
+// static_environment
+constexpr int static_sqrt(int n, int r = 0) {
+  return (r + 1) * (r + 1) > n ? r : static_sqrt(n, r + 1);
+}
+
+// returns b^e. It is evaluated at compile time to check the parameters of a
+// static_environment
+constexpr long long static_power(long long b, int e) {
+  return e == 0 ? 1 : b * static_power(b, e - 1);
+}
+
+// limbs of a bitmask of WordSize bits, found at compile time
+template <int WordSize>
+struct static_mask {
+  uint64_t limbs[basic_big_int<WordSize>::limb_count];
+};
+
+// returns the bitmask with the bits first + i * step set, for each i below
+// count. It is evaluated at compile time to build the bitmasks of a
+// static_environment
+template <int WordSize>
+constexpr static_mask<WordSize> static_bits(int first, int step, int count) {
+  static_mask<WordSize> res{};
+  for (int i = 0; i < count; i++) {
+    int b = first + i * step;
+    if (b >= 0 and b < WordSize) {
+      res.limbs[b / LSIZE] |= uint64_t(1) << (b % LSIZE);
+    }
+  }
+  return res;
+}
+
+// bitmasks base << i, where base has the limb low followed by limbs high,
+// calculated when they are read instead of kept in a table of word_size words.
+// It has the same operator[] as the tables of basic_environment, but returns
+// an expression, so the shift is folded into the expression that reads it
+template <class word>
+class shifted_mask {
+ private:
+  uint64_t low, high;  // limbs of the bitmask shifted by the index
+
+ public:
+  shifted_mask(uint64_t low_, uint64_t high_) : low(low_), high(high_) {}
+
+  // returns base << i
+  const big_int_shifted_mask<word::bits> operator[](int i) const {
+    COUNT_OP(op_shift);
+    return big_int_shifted_mask<word::bits>(low, high, i);
+  }
+};
+
+// environment whose word size, element size and capacity are fixed at compile
+// time. Its words are basic_big_int<WordSize>. The restrictions on the
+// parameters are checked when it is compiled, and instead of the three tables
+// of word_size words of basic_environment, it calculates the bitmasks shift_1,
+// shift_neg_1 and shift_neg_0 from the index. The bitmasks of
+// fast_most_significant_bit are found at compile time. It is used as the
+// second parameter of a basic_fusiontree or basic_fusion_btree
+template <int WordSize, int ElementSize, int Capacity>
+class static_environment
+    : private basic_environment<basic_big_int<WordSize> > {
+ public:
+  typedef basic_big_int<WordSize> word;  // words of the fusion trees
+
+  // the restrictions of the constructor of basic_environment, checked at
+  // compile time
+  static_assert(static_sqrt(ElementSize) * static_sqrt(ElementSize) ==
+                    ElementSize,
+                "element_size is not a square");
+  static_assert(static_power(Capacity, 5) <= ElementSize,
+                "element_size is too small for the fusion tree capacity");
+  static_assert(static_power(Capacity, 5) + static_power(Capacity, 4) <=
+                    WordSize,
+                "word_size is too small for the fusion tree capacity");
+
+  using basic_environment<word>::word_size;
+  using basic_environment<word>::element_size;
+  using basic_environment<word>::sqrt_element_size;
+  using basic_environment<word>::capacity;
+  using basic_environment<word>::sketching;
+  using basic_environment<word>::construction;
+
+  // bitmasks 1 << i, ~1 << i and ~0 << i
+  const shifted_mask<word> shift_1, shift_neg_1, shift_neg_0;
+
+  using basic_environment<word>::word_ram_most_significant_bit;
+  using basic_environment<word>::fast_most_significant_bit;
+  using basic_environment<word>::fast_first_diff;
+
+  explicit static_environment(
+      sketch_mode sketching_ = auto_sketching,
+      construction_mode construction_ = adjacent_construction);
+
+ private:
+  // returns the bitmasks of fast_most_significant_bit, copied from limbs
+  // found at compile time
+  static environment_masks<word> masks();
+};
+
+// static environment constructor. It only copies the bitmasks of
+// fast_most_significant_bit and builds the multipliers by two of them, which
+// have O(sqrt(element_size)) set bits
+
+template <int WordSize, int ElementSize, int Capacity>
+static_environment<WordSize, ElementSize, Capacity>::static_environment(
+    sketch_mode sketching_, construction_mode construction_)
+    : basic_environment<word>(WordSize, ElementSize, Capacity, sketching_,
+                              construction_, false, masks()),
+      shift_1(1, 0),
+      shift_neg_1(~uint64_t(1), ~uint64_t(0)),
+      shift_neg_0(~uint64_t(0), ~uint64_t(0)) {}
+
+// the bitmasks are the ones found by environment_masks. With s the square root
+// of the element size, each of them has its bits in an arithmetic progression
+
+template <int WordSize, int ElementSize, int Capacity>
+environment_masks<typename static_environment<WordSize, ElementSize,
+                                              Capacity>::word>
+static_environment<WordSize, ElementSize, Capacity>::masks() {
+  static constexpr int s = static_sqrt(ElementSize);
+  static constexpr static_mask<WordSize> clusters_first_bits =
+      static_bits<WordSize>(s - 1, s, s);
+  static constexpr static_mask<WordSize> perfect_sketch_m =
+      static_bits<WordSize>(ElementSize - (s - 1), 1 - s, s);
+  static constexpr static_mask<WordSize> repeat_int =
+      static_bits<WordSize>(0, s + 1, s);
+  static constexpr static_mask<WordSize> powers_of_two =
+      static_bits<WordSize>(s - 1, s, s);
+  static constexpr static_mask<WordSize> interposed_bits =
+      static_bits<WordSize>(s, s + 1, s);
+  static constexpr static_mask<WordSize> cluster_bits =
+      static_bits<WordSize>(0, 1, s);
+  static constexpr static_mask<WordSize> cluster_sum_bits =
+      static_bits<WordSize>(0, 1, s + 1);
+
+  environment_masks<word> res;
+  res.clusters_first_bits = word(clusters_first_bits.limbs, word::limb_count);
+  res.perfect_sketch_m = word(perfect_sketch_m.limbs, word::limb_count);
+  res.repeat_int = word(repeat_int.limbs, word::limb_count);
+  res.powers_of_two = word(powers_of_two.limbs, word::limb_count);
+  res.interposed_bits = word(interposed_bits.limbs, word::limb_count);
+  res.cluster_bits = word(cluster_bits.limbs, word::limb_count);
+  res.cluster_sum_bits = word(cluster_sum_bits.limbs, word::limb_count);
+  return res;
+}
+
+// the static environment with the default parameters of environment is
+// compiled once, in static_environment.cpp
+extern template class static_environment<WSIZE, 3136, 5>;
+extern template class basic_fusiontree<big_int,
+                                       static_environment<WSIZE, 3136, 5> >;
+
+#endif /* static_environment_hpp */
@@ -0,0 +1,101 @@
+//
+//  test_batch.cpp
+//  Fusion Tree
+//
+//  checks find_predecessor_batch of fusion tree nodes and of B-trees against
+//  std::set::upper_bound, for batches of 0, 1, 15, 16, 17 and 33 queries: the
+//  nodes answer the queries in blocks of 16, so these sizes give no block, a
+//  partial block, a full one and full blocks followed by partial ones. The
+//  trees are built with exact and approximate sketches, and include empty
+//  ones. Also checks that the answers past the end of the batch are not
+//  written
+//
+
+#include <stdio.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+typedef basic_fusiontree<word, env_type> fusiontree_type;
+typedef basic_fusion_btree<word, env_type> btree_type;
+
+const int batch_sizes[] = {0, 1, 15, 16, 17, 33};
+
+// answers the first queries of each batch size with find_predecessor_batch
+// and checks them against the upper bounds in expected. A sentinel follows
+// the answers, and must be left as it is
+template <class tree_type>
+static void check_batches(const tree_type &tree, const set<word> &expected,
+                          const vector<word> &queries, const char *what) {
+  for (int n : batch_sizes) {
+    vector<int> out(n + 1, -2);
+    tree.find_predecessor_batch(queries.data(), n, out.data());
+    for (int i = 0; i < n; i++) {
+      set<word>::const_iterator it = expected.upper_bound(queries[i]);
+      int predecessor = int(distance(expected.begin(), it)) - 1;
+      if (out[i] != predecessor) {
+        fprintf(stderr, "%s: query %d of a batch of %d is %d instead of %d\n",
+                what, i, n, out[i], predecessor);
+        failures++;
+        return;
+      }
+    }
+    if (out[n] != -2) {
+      fprintf(stderr, "%s: a batch of %d wrote past its end\n", what, n);
+      failures++;
+      return;
+    }
+  }
+}
+
+// nodes of every size and B-trees of several sizes over env. The queries are
+// the elements, the elements plus one and random integers, mixed
+static void test_random(const env_type &env, mt19937_64 &rng) {
+  vector<word> elements;
+  for (int i = 0; i < 100; i++) elements.push_back(random_word<word>(rng, 256));
+  vector<word> queries;
+  for (int i = 0; i < 33; i++) {
+    const word &x = elements[rng() % 20];
+    if (i % 3 == 0) queries.push_back(x);
+    if (i % 3 == 1) queries.push_back(x + word(1));
+    if (i % 3 == 2) queries.push_back(random_word<word>(rng, 256));
+  }
+
+  for (int n = 0; n <= env.capacity; n++) {
+    vector<word> node_elements(elements.begin(), elements.begin() + n);
+    fusiontree_type node(node_elements, &env);
+    check_batches(node, set<word>(node_elements.begin(), node_elements.end()),
+                  queries, "node");
+  }
+
+  int tree_sizes[] = {0, 1, 20, 100};
+  for (int n : tree_sizes) {
+    vector<word> tree_elements(elements.begin(), elements.begin() + n);
+    btree_type tree(tree_elements, &env);
+    check_batches(tree, set<word>(tree_elements.begin(), tree_elements.end()),
+                  queries, "B-tree");
+  }
+}
+
+int main() {
+  mt19937_64 rng(2021);
+  env_type exact_env(1024, 256, 3, exact_sketching);
+  env_type approximate_env(1024, 256, 3, approximate_sketching);
+  for (int trial = 0; trial < 5; trial++) {
+    test_random(exact_env, rng);
+    test_random(approximate_env, rng);
+  }
+  if (failures > 0) return 1;
+  printf("test_batch: ok\n");
+  return 0;
+}
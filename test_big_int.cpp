@@ -0,0 +1,336 @@
+//
+//  test_big_int.cpp
+//  Fusion Tree
+//
+//  checks the arithmetic of basic_big_int against std::bitset, at widths that
+//  are and are not multiples of 64 bits: the additions and subtractions with
+//  their carries across limbs, the multiplication, the shifts and bitwise
+//  operators, the comparisons of lazy expressions, and the expressions that
+//  read the integer they are assigned to, as t = t << s or t -= t << 1. Then
+//  the sparse multiplier, most_significant_bit, first_diff, next_set_bit,
+//  next_clear_bit, set_bit and extract_bits, which uses pext when the
+//  processor has it. Last, compares most_significant_bit and first_diff with
+//  the word RAM routines of the environment, on random integers and on the
+//  edges: zero, one, the top bit of the element and the bits next to each
+//  limb boundary
+//
+
+#include <stdio.h>
+
+#include <bitset>
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// reports a failed check of width Bits
+static void fail(const char *what, int bits) {
+  if (failures < 20) fprintf(stderr, "%s, at %d bits\n", what, bits);
+  failures++;
+}
+
+// returns the bits of x
+template <int Bits>
+static bitset<Bits> to_bitset(const basic_big_int<Bits> &x) {
+  bitset<Bits> res;
+  for (int i = 0; i < Bits; i++) {
+    res[i] = (x.data()[i / LSIZE] >> (i % LSIZE)) & 1;
+  }
+  return res;
+}
+
+// a + b, modulo 2^Bits
+template <size_t Bits>
+static bitset<Bits> add(const bitset<Bits> &a, const bitset<Bits> &b) {
+  bitset<Bits> res;
+  bool carry = false;
+  for (size_t i = 0; i < Bits; i++) {
+    res[i] = a[i] ^ b[i] ^ carry;
+    carry = (a[i] and b[i]) or (carry and (a[i] or b[i]));
+  }
+  return res;
+}
+
+// a - b, modulo 2^Bits
+template <size_t Bits>
+static bitset<Bits> subtract(const bitset<Bits> &a, const bitset<Bits> &b) {
+  bitset<Bits> one;
+  one[0] = 1;
+  return add(a, add(~b, one));
+}
+
+// a * b, modulo 2^Bits
+template <size_t Bits>
+static bitset<Bits> multiply(const bitset<Bits> &a, const bitset<Bits> &b) {
+  bitset<Bits> res;
+  for (size_t i = 0; i < Bits; i++) {
+    if (b[i]) res = add(res, a << i);
+  }
+  return res;
+}
+
+// -1, 0 or 1 as a is smaller than, equal to or larger than b
+template <size_t Bits>
+static int compare(const bitset<Bits> &a, const bitset<Bits> &b) {
+  for (int i = int(Bits) - 1; i >= 0; i--) {
+    if (a[i] != b[i]) return a[i] ? 1 : -1;
+  }
+  return 0;
+}
+
+// returns a random integer, with all its bits random, few or many bits set,
+// or a long run of ones, so that the carries cross many limbs
+template <int Bits>
+static bitset<Bits> random_bits(mt19937_64 &rng) {
+  bitset<Bits> res;
+  int kind = rng() % 5;
+  for (int i = 0; i < Bits; i++) {
+    if (kind == 0) res[i] = rng() & 1;
+    if (kind == 1) res[i] = rng() % 64 == 0;
+    if (kind == 2) res[i] = rng() % 64 != 0;
+    if (kind == 3) res[i] = i >= Bits / 3;
+  }
+  if (kind == 4) res = bitset<Bits>(rng());
+  return res;
+}
+
+// checks that x has the bits of expected
+template <int Bits>
+static void check(const basic_big_int<Bits> &x,
+                  const bitset<size_t(Bits)> &expected, const char *what) {
+  if (to_bitset(x) != expected) fail(what, Bits);
+}
+
+// random operations at width Bits, multiplications only in the first
+// multiplications trials, since the reference takes Bits additions
+template <int Bits>
+static void test_width(mt19937_64 &rng, int trials, int multiplications) {
+  typedef basic_big_int<Bits> word;
+  for (int trial = 0; trial < trials; trial++) {
+    bitset<Bits> ra = random_bits<Bits>(rng), rb = random_bits<Bits>(rng),
+                 rc = random_bits<Bits>(rng);
+    word a(ra), b(rb), c(rc);
+    int s = rng() % (Bits + 2);
+    check(a, ra, "bitset constructor");
+
+    // operators and expressions of several of them
+    check(word(a + b), add(ra, rb), "a + b");
+    check(word(a - b), subtract(ra, rb), "a - b");
+    check(word(-a), subtract(bitset<Bits>(), ra), "-a");
+    check(word(a & b), ra & rb, "a & b");
+    check(word(a | b), ra | rb, "a | b");
+    check(word(a ^ b), ra ^ rb, "a ^ b");
+    check(word(~a), ~ra, "~a");
+    check(word(a << s), ra << s, "a << s");
+    check(word(a >> s), ra >> s, "a >> s");
+    check(word((a + b) ^ (c << s)), add(ra, rb) ^ (rc << s),
+          "(a + b) ^ (c << s)");
+    check(word(((a << s) - b) & ~c), subtract(ra << s, rb) & ~rc,
+          "((a << s) - b) & ~c");
+    check(word((a - (b >> s)) + (c | a)), add(subtract(ra, rb >> s), rc | ra),
+          "(a - (b >> s)) + (c | a)");
+
+    // expressions that read the integer they are assigned to
+    word t = a;
+    t = t << s;
+    check(t, ra << s, "t = t << s");
+    t = a;
+    t = t >> s;
+    check(t, ra >> s, "t = t >> s");
+    t = a;
+    t -= t << 1;
+    check(t, subtract(ra, ra << 1), "t -= t << 1");
+    t = a;
+    t += t >> 1;
+    check(t, add(ra, ra >> 1), "t += t >> 1");
+    t = a;
+    t ^= t << 3;
+    check(t, ra ^ (ra << 3), "t ^= t << 3");
+    t = a;
+    t = b - (t << 2);
+    check(t, subtract(rb, ra << 2), "t = b - (t << 2)");
+    t = a;
+    t <<= s;
+    check(t, ra << s, "t <<= s");
+    t = a;
+    t >>= s;
+    check(t, ra >> s, "t >>= s");
+    t = a;
+    t &= b | c;
+    check(t, ra & (rb | rc), "t &= b | c");
+
+    if (trial < multiplications) {
+      check(word(a * b), multiply(ra, rb), "a * b");
+      t = a;
+      t *= t;
+      check(t, multiply(ra, ra), "t *= t");
+      t = a;
+      t *= b;
+      check(t, multiply(ra, rb), "t *= b");
+    }
+
+    // comparisons of integers and of lazy expressions
+    int cmp = compare(ra, rb);
+    if ((a < b) != (cmp < 0) or (a <= b) != (cmp <= 0) or
+        (a > b) != (cmp > 0) or (a >= b) != (cmp >= 0) or
+        (a == b) != (cmp == 0) or (a != b) != (cmp != 0)) {
+      fail("comparison of a and b", Bits);
+    }
+    cmp = compare(add(ra, rb), rc ^ ra);
+    if (((a + b) < (c ^ a)) != (cmp < 0) or
+        ((a + b) == (c ^ a)) != (cmp == 0) or
+        ((a + b) >= (c ^ a)) != (cmp >= 0)) {
+      fail("comparison of expressions", Bits);
+    }
+    if (!(a == a) or a != a or a < a or !(a <= a)) {
+      fail("comparison of a with itself", Bits);
+    }
+
+    // multiplication by a constant with few set bits
+    bitset<Bits> rm;
+    for (int i = 0; i < 4; i++) rm[rng() % Bits] = 1;
+    sparse_multiplier m((word(rm)));
+    word product;
+    m.multiply(a, product);
+    check(product, multiply(ra, rm), "sparse multiply into");
+    check(m.multiply(a), multiply(ra, rm), "sparse multiply");
+    check(word((a ^ b) * m), multiply(ra ^ rb, rm), "expression * sparse");
+    t = a;
+    t *= m;
+    check(t, multiply(ra, rm), "t *= sparse");
+
+    // bit scans
+    int msb = -1, diff = -1;
+    for (int i = Bits - 1; i >= 0 and msb < 0; i--) {
+      if (ra[i]) msb = i;
+    }
+    for (int i = Bits - 1; i >= 0 and diff < 0; i--) {
+      if (ra[i] != rb[i]) diff = i;
+    }
+    if (a.most_significant_bit() != msb) fail("most_significant_bit", Bits);
+    if (a.first_diff(b) != diff or a.first_diff(a) != -1) {
+      fail("first_diff", Bits);
+    }
+    int from = rng() % (Bits + 1);
+    int set_bit = -1, clear_bit = -1;
+    for (int i = from; i < Bits and set_bit < 0; i++) {
+      if (ra[i]) set_bit = i;
+    }
+    for (int i = from; i < Bits and clear_bit < 0; i++) {
+      if (!ra[i]) clear_bit = i;
+    }
+    if (a.next_set_bit(from) != set_bit) fail("next_set_bit", Bits);
+    if (a.next_clear_bit(from) != clear_bit) fail("next_clear_bit", Bits);
+    int bit = rng() % Bits;
+    t = a;
+    t.set_bit(bit);
+    bitset<Bits> rt = ra;
+    rt[bit] = 1;
+    check(t, rt, "set_bit");
+
+    // extract_bits gathers up to 64 bits selected by a mask
+    bitset<Bits> rmask;
+    int mask_bits = rng() % 65;
+    for (int i = 0; i < mask_bits; i++) rmask[rng() % Bits] = 1;
+    uint64_t expected = 0;
+    int k = 0;
+    for (int i = 0; i < Bits; i++) {
+      if (rmask[i]) expected |= uint64_t(ra[i]) << k++;
+    }
+    if (a.extract_bits(word(rmask)) != expected) fail("extract_bits", Bits);
+
+    // the small integers
+    int small = rng() & 0x7fffffff;
+    check(word(small), bitset<Bits>(small), "small integer");
+    if (int(word(small)) != small) fail("int of a small integer", Bits);
+  }
+}
+
+// compares the bit scans of basic_big_int<Bits> with
+// word_ram_most_significant_bit and with fast_most_significant_bit and
+// fast_first_diff of an environment of element_size bits, which take the word
+// RAM routine unless the program is built with NAIVE=1
+template <int Bits>
+static void test_word_ram(mt19937_64 &rng, int element_size, int trials) {
+  typedef basic_big_int<Bits> word;
+  basic_environment<word> env(Bits, element_size, 2);
+
+  // the edges: single bits and the integers below them, at both sides of
+  // each limb boundary of the element and at its ends
+  vector<int> edge_bits = {0, 1, element_size - 2, element_size - 1};
+  for (int i = LSIZE; i < element_size; i += LSIZE) {
+    edge_bits.push_back(i - 1);
+    edge_bits.push_back(i);
+  }
+  vector<word> values = {word(0), word(1)};
+  for (int bit : edge_bits) {
+    word single = word(1) << bit;
+    values.push_back(single);
+    values.push_back(single - word(1));
+    values.push_back(single | word(1));
+  }
+  // random integers of random lengths, and of the whole element
+  for (int i = 0; i < trials; i++) {
+    int bits = i % 2 ? element_size : int(rng() % (element_size + 1));
+    word x(random_bits<Bits>(rng));
+    values.push_back(x & ((word(1) << bits) - word(1)));
+  }
+
+  for (int i = 0; i < (int)values.size(); i++) {
+    const word &x = values[i];
+    int expected = -1;
+    bitset<Bits> rx = to_bitset(x);
+    for (int j = 0; j < Bits; j++) {
+      if (rx[j]) expected = j;
+    }
+    if (x.most_significant_bit() != expected) {
+      fail("most_significant_bit", Bits);
+    }
+    if (env.word_ram_most_significant_bit(x) != expected) {
+      fail("word_ram_most_significant_bit", Bits);
+    }
+    if (env.fast_most_significant_bit(x) != expected) {
+      fail("fast_most_significant_bit", Bits);
+    }
+
+    // y differs from x first at an edge or at a random bit, and may differ
+    // below it too
+    int bit = i % 2 ? edge_bits[rng() % edge_bits.size()]
+                    : int(rng() % element_size);
+    word below = (word(1) << bit) - word(1);
+    word y = x ^ (word(1) << bit);
+    if (rng() % 2) y = y ^ (values[rng() % values.size()] & below);
+    if (x.first_diff(y) != bit or y.first_diff(x) != bit) {
+      fail("first_diff", Bits);
+    }
+    if (env.word_ram_most_significant_bit(x ^ y) != bit or
+        env.fast_first_diff(x, y) != bit) {
+      fail("fast_first_diff", Bits);
+    }
+    if (x.first_diff(x) != -1 or env.fast_first_diff(x, x) != -1) {
+      fail("first_diff of equal integers", Bits);
+    }
+  }
+}
+
+int main() {
+  mt19937_64 rng(2021);
+  test_width<64>(rng, 300, 300);
+  test_width<100>(rng, 300, 300);
+  test_width<128>(rng, 300, 300);
+  test_width<130>(rng, 300, 300);
+  test_width<200>(rng, 300, 100);
+  test_width<512>(rng, 100, 20);
+  test_width<4000>(rng, 20, 2);
+  test_word_ram<512>(rng, 256, 1000);
+  test_word_ram<1024>(rng, 576, 500);
+  test_word_ram<2048>(rng, 1024, 200);
+  test_word_ram<4000>(rng, 3136, 100);
+  if (failures > 0) return 1;
+  printf("test_big_int: ok\n");
+  return 0;
+}
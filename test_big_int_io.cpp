@@ -0,0 +1,301 @@
+//
+//  test_big_int_io.cpp
+//  Fusion Tree
+//
+//  checks that basic_big_int is written and read back unchanged, at widths
+//  that are and are not multiples of 64 bits: in hexadecimal, in little and
+//  big endian bytes, with fewer bytes than the integer, which drop its high
+//  bytes, and with more, which are zero above it, in limbs and through view.
+//  Then the key files of big_int_io.hpp: written by write_big_ints and read
+//  back by read_big_ints and map_big_ints, and hexadecimal files read by
+//  read_hex_big_ints, with the errors of each of them
+//
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "big_int.hpp"
+#include "big_int_io.hpp"
+#include "fusion_file.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+static const char *key_path = "test_big_int_io.keys";
+static const char *hex_path = "test_big_int_io.txt";
+
+// order of the bytes of the machine, the one of the files mapped in place
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static const byte_order machine_order = little_endian_order;
+#else
+static const byte_order machine_order = big_endian_order;
+#endif
+
+// reports a failed check of width Bits
+static void fail(const char *what, int bits) {
+  if (failures < 20) fprintf(stderr, "%s, at %d bits\n", what, bits);
+  failures++;
+}
+
+// returns true if calling f throws a string
+template <class function_type>
+static bool throws(function_type f) {
+  try {
+    f();
+  } catch (string &) {
+    return true;
+  }
+  return false;
+}
+
+// returns a random integer of width Bits, with all its bits random, only its
+// low limb, or its most significant bit set, so that the high bytes and
+// digits are sometimes zero and sometimes not
+template <int Bits>
+static basic_big_int<Bits> random_word(mt19937_64 &rng) {
+  typedef basic_big_int<Bits> word;
+  uint64_t limbs[word::limb_count];
+  for (int i = 0; i < word::limb_count; i++) limbs[i] = rng();
+  int kind = rng() % 4;
+  if (kind == 0) return word(limbs, 1);
+  if (kind == 1) return word(limbs, word::limb_count) | (word(1) << (Bits - 1));
+  return word(limbs, word::limb_count);
+}
+
+// returns the k-th least significant byte of x, zero above Bits
+template <int Bits>
+static uint8_t byte_of(const basic_big_int<Bits> &x, size_t k) {
+  if (k / 8 >= (size_t)basic_big_int<Bits>::limb_count) return 0;
+  return uint8_t(x.data()[k / 8] >> (8 * (k % 8)));
+}
+
+// returns the n least significant bytes of x in the given order
+template <int Bits>
+static vector<uint8_t> expected_bytes(const basic_big_int<Bits> &x, size_t n,
+                                      byte_order order) {
+  vector<uint8_t> res(n);
+  for (size_t k = 0; k < n; k++) {
+    res[order == little_endian_order ? k : n - 1 - k] = byte_of(x, k);
+  }
+  return res;
+}
+
+// returns x in lowercase hexadecimal without leading zeros, a digit at a time
+template <int Bits>
+static string expected_hex(const basic_big_int<Bits> &x) {
+  static const char digits[] = "0123456789abcdef";
+  string res;
+  for (int i = (Bits + 3) / 4 - 1; i >= 0; i--) {
+    int digit = (x.data()[i / 16] >> (4 * (i % 16))) & 15;
+    if (digit != 0 or !res.empty()) res += digits[digit];
+  }
+  return res.empty() ? "0" : res;
+}
+
+// returns x with only its n least significant bytes
+template <int Bits>
+static basic_big_int<Bits> low_bytes(const basic_big_int<Bits> &x, size_t n) {
+  typedef basic_big_int<Bits> word;
+  if (n * 8 >= (size_t)Bits) return x;
+  return x & ((word(1) << int(n * 8)) - word(1));
+}
+
+// hexadecimal, byte, limb and view round trips of random integers
+template <int Bits>
+static void test_round_trips(mt19937_64 &rng, int trials) {
+  typedef basic_big_int<Bits> word;
+  const size_t bytes = (Bits + 7) / 8;
+  const byte_order orders[] = {little_endian_order, big_endian_order};
+
+  for (int trial = 0; trial < trials; trial++) {
+    word x = random_word<Bits>(rng);
+
+    // hexadecimal, with and without a prefix, in both cases
+    string hex = x.to_hex();
+    if (hex != expected_hex(x)) fail("to_hex", Bits);
+    string upper = hex;
+    for (char &c : upper) c = toupper(c);
+    if (word::from_hex(hex) != x or word::from_hex("0x" + hex) != x or
+        word::from_hex("0X" + upper) != x or
+        word::from_hex("000" + hex) != x) {
+      fail("from_hex of to_hex", Bits);
+    }
+    // digits above Bits are dropped
+    if (word::from_hex("f" + string((Bits + 3) / 4, '0') + hex) != x) {
+      fail("from_hex of digits above the integer", Bits);
+    }
+
+    // bytes: exactly the integer, fewer bytes and more bytes
+    const size_t counts[] = {bytes, 1, bytes / 2, bytes - 1, bytes + 1,
+                             bytes + 8, bytes + 13,
+                             8 * (size_t)word::limb_count};
+    for (byte_order order : orders) {
+      for (size_t n : counts) {
+        vector<uint8_t> buffer(n, 0xa5);
+        x.to_bytes(buffer.data(), n, order);
+        if (buffer != expected_bytes(x, n, order)) fail("to_bytes", Bits);
+        if (word(buffer.data(), n, order) != low_bytes(x, n)) {
+          fail("constructor from the bytes of to_bytes", Bits);
+        }
+      }
+      // bytes set above Bits are dropped, whatever their number
+      vector<uint8_t> buffer(bytes + 9, 0xff);
+      if (word(buffer.data(), buffer.size(), order) != ~word(0)) {
+        fail("constructor from bytes above the integer", Bits);
+      }
+    }
+
+    // limbs, with missing limbs and more limbs than the integer
+    vector<uint64_t> limbs(word::limb_count + 2, 7);
+    x.to_limbs(limbs.data(), limbs.size());
+    if (word(limbs.data(), word::limb_count) != x or
+        word(limbs.data(), limbs.size()) != x or
+        limbs[word::limb_count] != 0 or limbs[word::limb_count + 1] != 0) {
+      fail("to_limbs", Bits);
+    }
+    if (word(limbs.data(), 1) != low_bytes(x, 8)) {
+      fail("constructor from fewer limbs", Bits);
+    }
+
+    // view of the limbs, which must have no bit above Bits
+    const word *view = word::view(limbs.data());
+    if (*view != x) fail("view", Bits);
+    if (Bits % 64 != 0) {
+      limbs[word::limb_count - 1] |= uint64_t(1) << 63;
+      if (!throws([&] { word::view(limbs.data()); })) {
+        fail("view of bits above the integer", Bits);
+      }
+    }
+  }
+
+  // zero, and the errors of from_hex
+  if (word(0).to_hex() != "0" or word::from_hex("0") != word(0) or
+      word::from_hex("0x0000") != word(0)) {
+    fail("hexadecimal of zero", Bits);
+  }
+  if (!throws([] { word::from_hex(""); }) or
+      !throws([] { word::from_hex("0x"); }) or
+      !throws([] { word::from_hex("12g4"); }) or
+      !throws([] { word::from_hex("-1"); })) {
+    fail("invalid hexadecimal number accepted", Bits);
+  }
+}
+
+// writes the given bytes into a file
+static void write_file(const char *path, const string &contents) {
+  FILE *file = fopen(path, "wb");
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+}
+
+// key files written and read back, with whole and partial keys, mapped in
+// place and in hexadecimal
+template <int Bits>
+static void test_files(mt19937_64 &rng, int n) {
+  typedef basic_big_int<Bits> word;
+  const size_t bytes = (Bits + 7) / 8;
+  const byte_order orders[] = {little_endian_order, big_endian_order};
+
+  vector<word> keys;
+  for (int i = 0; i < n; i++) keys.push_back(random_word<Bits>(rng));
+
+  // the bytes of each key in both orders, also truncated and padded
+  const size_t counts[] = {bytes, 3, bytes + 5};
+  for (byte_order order : orders) {
+    for (size_t key_bytes : counts) {
+      write_big_ints(key_path, keys, key_bytes, order);
+      vector<word> read = read_big_ints<Bits>(key_path, key_bytes, order);
+      bool same = read.size() == keys.size();
+      for (int i = 0; i < n and same; i++) {
+        same = read[i] == low_bytes(keys[i], key_bytes);
+      }
+      if (!same) fail("read_big_ints of write_big_ints", Bits);
+    }
+  }
+  write_file(key_path, string(2 * bytes + 1, 'x'));
+  if (!throws([&] { read_big_ints<Bits>(key_path, bytes, machine_order); }) or
+      !throws([&] { read_big_ints<Bits>(key_path, 0, machine_order); })) {
+    fail("read_big_ints of a partial key", Bits);
+  }
+
+  // whole limbs in the order of the machine are mapped in place
+  write_big_ints(key_path, keys, sizeof(word), machine_order);
+  {
+    mapped_file file(key_path);
+    size_t count;
+    const word *mapped = map_big_ints<Bits>(file, count);
+    bool same = count == keys.size();
+    for (int i = 0; i < n and same; i++) same = mapped[i] == keys[i];
+    if (!same) fail("map_big_ints of write_big_ints", Bits);
+  }
+  // a file that is not a multiple of the integers, or has bits set above Bits
+  write_file(key_path, string(2 * sizeof(word) + 4, '\0'));
+  {
+    mapped_file file(key_path);
+    size_t count;
+    if (!throws([&] { map_big_ints<Bits>(file, count); })) {
+      fail("map_big_ints of a partial key", Bits);
+    }
+  }
+  if (Bits % 64 != 0) {
+    write_file(key_path, string(2 * sizeof(word), '\xff'));
+    mapped_file file(key_path);
+    size_t count;
+    if (!throws([&] { map_big_ints<Bits>(file, count); })) {
+      fail("map_big_ints of bits above the integer", Bits);
+    }
+  }
+
+  // hexadecimal files, with empty lines, prefixes, uppercase digits, spaces
+  // and carriage returns at the end of the lines, and a line longer than the
+  // buffer of read_hex_big_ints
+  string text;
+  for (int i = 0; i < n; i++) {
+    string hex = keys[i].to_hex();
+    if (i % 4 == 1) hex = "0x" + hex;
+    if (i % 4 == 2) {
+      for (char &c : hex) c = toupper(c);
+    }
+    if (i % 4 == 3) hex = string(5000, '0') + hex;
+    text += hex + (i % 3 == 0 ? "\r\n" : i % 3 == 1 ? "  \n\n" : "\n");
+  }
+  write_file(hex_path, text);
+  vector<word> read = read_hex_big_ints<Bits>(hex_path);
+  if (read != keys) fail("read_hex_big_ints", Bits);
+  write_file(hex_path, text + "12 34\n");
+  if (!throws([] { read_hex_big_ints<Bits>(hex_path); })) {
+    fail("read_hex_big_ints of an invalid line", Bits);
+  }
+}
+
+int main() {
+  mt19937_64 rng(2021);
+  test_round_trips<64>(rng, 200);
+  test_round_trips<100>(rng, 200);
+  test_round_trips<130>(rng, 200);
+  test_round_trips<200>(rng, 200);
+  test_round_trips<512>(rng, 100);
+  test_round_trips<4000>(rng, 20);
+  test_files<64>(rng, 100);
+  test_files<100>(rng, 100);
+  test_files<130>(rng, 100);
+  test_files<200>(rng, 100);
+  test_files<WSIZE>(rng, 20);
+
+  if (!throws([] { read_big_ints<100>("no_such_file.keys", 13,
+                                      little_endian_order); }) or
+      !throws([] { read_hex_big_ints<100>("no_such_file.txt"); })) {
+    fail("a missing file was read", 100);
+  }
+
+  remove(key_path);
+  remove(hex_path);
+  if (failures > 0) return 1;
+  printf("test_big_int_io: ok\n");
+  return 0;
+}
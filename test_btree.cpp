@@ -0,0 +1,209 @@
+//
+//  test_btree.cpp
+//  Fusion Tree
+//
+//  checks the insertions, removals, predecessors and range counts of
+//  fusion_btree against std::set, at every capacity from 2 to 5, each with the
+//  smallest word that fits it, starting from bulk loaded B-trees of several
+//  sizes. Capacity 2 leaves nodes other than the root with a single child,
+//  which must be removed when they are left empty. Also checks the ranges
+//  of single fusion tree nodes, and that a fusion tree that was moved from is
+//  left empty and usable
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks that the B-tree keeps the elements of expected, querying each
+// integer from 0 to range
+template <class word, class btree_type>
+static void check(const btree_type &tree, const set<int> &expected, int range,
+                  const char *what) {
+  vector<int> sorted(expected.begin(), expected.end());
+  if (tree.size() != (int)sorted.size()) {
+    fprintf(stderr, "%s: size %d instead of %d\n", what, tree.size(),
+            (int)sorted.size());
+    failures++;
+    return;
+  }
+  for (int i = 0; i < (int)sorted.size(); i++) {
+    if (tree.pos(i) != word(sorted[i])) {
+      fprintf(stderr, "%s: wrong element of rank %d\n", what, i);
+      failures++;
+      return;
+    }
+  }
+  for (int x = 0; x <= range; x++) {
+    int expected_rank =
+        int(upper_bound(sorted.begin(), sorted.end(), x) - sorted.begin()) - 1;
+    if (tree.find_predecessor(word(x)) != expected_rank) {
+      fprintf(stderr, "%s: find_predecessor(%d) is %d instead of %d\n", what, x,
+              tree.find_predecessor(word(x)), expected_rank);
+      failures++;
+      return;
+    }
+    // one interval for every third x, some of them empty or reversed
+    if (x % 3 != 0) continue;
+    int y = (x * 37 + 11) % (range + 1);
+    int expected_count = 0;
+    for (int k : sorted) expected_count += (x <= k and k < y);
+    if (tree.count_range(word(x), word(y)) != expected_count) {
+      fprintf(stderr, "%s: count_range(%d, %d) is %d instead of %d\n", what, x,
+              y, tree.count_range(word(x), word(y)), expected_count);
+      failures++;
+      return;
+    }
+  }
+}
+
+// an erase that empties the only child of an internal node at capacity 2
+static void test_single_child() {
+  typedef basic_big_int<512> word;
+  basic_environment<word> env(512, 64, 2);
+  vector<word> elements = {19, 4, 8, 3, 13};
+  basic_fusion_btree<word> tree(elements, &env);
+  set<int> expected = {19, 4, 8, 3, 13};
+
+  tree.insert(word(11));
+  expected.insert(11);
+  tree.erase(word(19));
+  expected.erase(19);
+  check<word>(tree, expected, 25, "single child");
+}
+
+// random insertions and removals, checked after each of them
+template <int Bits>
+static void test_random(int element_size, int capacity, int initial,
+                        mt19937 &rng) {
+  typedef basic_big_int<Bits> word;
+  basic_environment<word> env(Bits, element_size, capacity);
+  const int range = 60;
+  set<int> expected;
+  vector<word> elements;
+  while ((int)expected.size() < initial) {
+    int x = rng() % range;
+    if (expected.insert(x).second) elements.push_back(word(x));
+  }
+  basic_fusion_btree<word> tree(elements, &env);
+  check<word>(tree, expected, range, "bulk load");
+
+  for (int step = 0; step < 300 and failures == 0; step++) {
+    int x = rng() % range;
+    if (rng() % 2) {
+      bool inserted = expected.insert(x).second;
+      if (tree.insert(word(x)) != inserted) {
+        fprintf(stderr, "insert(%d) at capacity %d: wrong result\n", x,
+                capacity);
+        failures++;
+      }
+    } else {
+      bool erased = expected.erase(x) > 0;
+      if (tree.erase(word(x)) != erased) {
+        fprintf(stderr, "erase(%d) at capacity %d: wrong result\n", x,
+                capacity);
+        failures++;
+      }
+    }
+    check<word>(tree, expected, range, "insert and erase");
+  }
+}
+
+// a moved-from fusion tree is empty, and takes new elements
+static void test_moved_from() {
+  typedef basic_big_int<1024> word;
+  basic_environment<word> env(1024, 256, 3);
+  vector<word> elements = {5, 9, 30};
+  basic_fusiontree<word> source(elements, &env);
+  basic_fusiontree<word> target(std::move(source));
+  check<word>(target, {5, 9, 30}, 40, "move target");
+  check<word>(source, {}, 40, "moved from");
+
+  set<int> expected;
+  for (int x : {17, 2, 33}) {
+    if (!source.insert(word(x))) {
+      fprintf(stderr, "moved from: insert(%d) failed\n", x);
+      failures++;
+    }
+    expected.insert(x);
+    check<word>(source, expected, 40, "insert after move");
+  }
+  source.erase(word(2));
+  expected.erase(2);
+  check<word>(source, expected, 40, "erase after move");
+  check<word>(target, {5, 9, 30}, 40, "move target");
+}
+
+// count_range and find_range of single nodes, for every interval of small
+// integers, including the empty and reversed ones
+static void test_node_ranges(mt19937 &rng) {
+  typedef basic_big_int<1024> word;
+  basic_environment<word> env(1024, 256, 3);
+  const int range = 40;
+  for (int trial = 0; trial < 20 and failures == 0; trial++) {
+    set<int> expected;
+    vector<word> elements;
+    int n = trial % (env.capacity + 1);
+    while ((int)expected.size() < n) {
+      int x = rng() % range;
+      if (expected.insert(x).second) elements.push_back(word(x));
+    }
+    basic_fusiontree<word> node(elements, &env);
+    for (int a = 0; a <= range; a++) {
+      for (int b = 0; b <= range; b++) {
+        vector<word> inside;
+        for (int x : expected) {
+          if (a <= x and x < b) inside.push_back(word(x));
+        }
+        basic_fusiontree<word>::range found =
+            node.find_range(word(a), word(b));
+        if (node.count_range(word(a), word(b)) != (int)inside.size() or
+            vector<word>(found.begin(), found.end()) != inside) {
+          fprintf(stderr, "node ranges: wrong interval [%d, %d)\n", a, b);
+          failures++;
+          return;
+        }
+      }
+    }
+  }
+}
+
+// a B-tree cannot be built at capacity 1
+static void test_capacity_one() {
+  typedef basic_big_int<512> word;
+  basic_environment<word> env(512, 64, 1);
+  vector<word> elements = {1, 2, 3};
+  try {
+    basic_fusion_btree<word> tree(elements, &env);
+    fprintf(stderr, "capacity 1 was accepted\n");
+    failures++;
+  } catch (string &) {
+  }
+}
+
+int main() {
+  test_single_child();
+  test_capacity_one();
+  test_moved_from();
+  mt19937 rng(2021);
+  test_node_ranges(rng);
+  for (int initial = 0; initial <= 40; initial += 10) {
+    test_random<512>(64, 2, initial, rng);
+    test_random<512>(256, 3, initial, rng);
+    test_random<2048>(1024, 4, initial, rng);
+    test_random<WSIZE>(3136, 5, initial, rng);
+  }
+  if (failures > 0) return 1;
+  printf("test_btree: ok\n");
+  return 0;
+}
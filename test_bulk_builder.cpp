@@ -0,0 +1,122 @@
+//
+//  test_bulk_builder.cpp
+//  Fusion Tree
+//
+//  builds fusion B-trees with the threads of basic_bulk_builder and checks
+//  them node by node against the same B-trees built in a single thread: both
+//  are saved, and the files, which keep every word of every node in
+//  breadth-first order, must be equal. The nodes built directly by the builder
+//  are checked against nodes built one by one in the same way. Built with
+//  "make SANITIZE=thread test", after "make clean", ThreadSanitizer also
+//  reports any data race of the builder
+//
+
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "bulk_builder.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+typedef basic_fusiontree<word, env_type> fusiontree_type;
+typedef basic_fusion_btree<word, env_type> btree_type;
+typedef basic_bulk_builder<word, env_type> builder_type;
+
+static const char *serial_path = "test_bulk_builder_serial.fus";
+static const char *parallel_path = "test_bulk_builder_parallel.fus";
+
+static void fail(const char *what, int n, int threads) {
+  fprintf(stderr, "%s, with %d elements and %d threads\n", what, n, threads);
+  failures++;
+}
+
+// returns the bytes of a file
+static vector<char> read_bytes(const char *path) {
+  vector<char> bytes;
+  FILE *file = fopen(path, "rb");
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + read);
+  }
+  fclose(file);
+  return bytes;
+}
+
+// checks that two trees, of any type with save, are saved into equal files
+template <class tree_type>
+static bool same_files(const tree_type &a, const tree_type &b) {
+  a.save(serial_path);
+  b.save(parallel_path);
+  return read_bytes(serial_path) == read_bytes(parallel_path);
+}
+
+// builds a B-tree over n random elements, with repetitions, serially and with
+// a builder of the given number of threads, and compares them
+static void test_btree(const env_type &env, builder_type &builder, int n,
+                       mt19937_64 &rng) {
+  vector<word> elements;
+  for (int i = 0; i < n; i++) {
+    elements.push_back(random_word<word>(rng, env.element_size));
+    if (i % 7 == 6) elements.push_back(elements[i / 2]);
+  }
+  vector<word> copy = elements;
+
+  btree_type serial(elements, &env);
+  btree_type parallel(copy, &env, builder);
+  if (serial.size() != parallel.size() or
+      serial.levels() != parallel.levels() or !same_files(serial, parallel)) {
+    fail("the B-trees differ", n, builder.size());
+  }
+}
+
+// builds the nodes over n sorted, distinct elements with the builder, and one
+// by one with the same split, and compares them
+static void test_nodes(const env_type &env, builder_type &builder, int n) {
+  vector<word> elements;
+  for (int i = 0; i < n; i++) elements.push_back(word(3 * i + 1));
+
+  vector<fusiontree_type *> nodes = builder.build(elements);
+  int first = 0;
+  for (int i = 0; i < (int)nodes.size(); i++) {
+    int count = nodes[i]->size();
+    vector<word> node_elements(elements.begin() + first,
+                               elements.begin() + first + count);
+    fusiontree_type node(node_elements, &env);
+    if (count == 0 or !same_files(node, *nodes[i])) {
+      fail("the nodes differ", n, builder.size());
+    }
+    first += count;
+    delete nodes[i];
+  }
+  if (first != n) fail("the nodes lose elements", n, builder.size());
+}
+
+int main() {
+  env_type env(1024, 256, 3);
+  mt19937_64 rng(2021);
+
+  const int thread_counts[] = {1, 3, 4};
+  const int sizes[] = {0, 1, 2, 3, 4, 10, 100, 1000};
+  for (int threads : thread_counts) {
+    builder_type builder(&env, threads);
+    for (int n : sizes) {
+      test_btree(env, builder, n, rng);
+      test_nodes(env, builder, n);
+    }
+  }
+
+  remove(serial_path);
+  remove(parallel_path);
+  if (failures > 0) return 1;
+  printf("test_bulk_builder: ok\n");
+  return 0;
+}
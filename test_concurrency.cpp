@@ -0,0 +1,136 @@
+//
+//  test_concurrency.cpp
+//  Fusion Tree
+//
+//  checks that the const queries of fusiontree and fusion_btree can run in many
+//  threads at once: several threads query the same const trees directly, and
+//  through basic_query_pool, and every answer is compared with the one of the
+//  same query made serially. Built with "make SANITIZE=thread test", after
+//  "make clean", ThreadSanitizer also reports any data race among them
+//
+
+#include <stdio.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "query_pool.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+typedef basic_fusiontree<word, env_type> fusiontree_type;
+typedef basic_fusion_btree<word, env_type> btree_type;
+
+// number of threads that query the trees at once
+static const int threads_count = 4;
+
+// answers of the queries of a tree, made serially
+struct answers {
+  vector<int> predecessor, successor, rank;
+};
+
+template <class tree_type>
+static answers serial_answers(const tree_type &tree,
+                              const vector<word> &queries) {
+  answers res;
+  for (int i = 0; i < (int)queries.size(); i++) {
+    res.predecessor.push_back(tree.find_predecessor(queries[i]));
+    res.successor.push_back(tree.find_successor(queries[i]));
+    res.rank.push_back(tree.rank(queries[i]));
+  }
+  return res;
+}
+
+// makes the queries of serial_answers in threads_count threads at once, each
+// starting at a different query, and compares them with expected
+template <class tree_type>
+static void check_threads(const tree_type &tree, const vector<word> &queries,
+                          const answers &expected) {
+  vector<thread> threads;
+  for (int t = 0; t < threads_count; t++) {
+    threads.push_back(thread([&, t]() {
+      int n = queries.size();
+      for (int k = 0; k < n; k++) {
+        int i = (k + t * n / threads_count) % n;
+        if (tree.find_predecessor(queries[i]) != expected.predecessor[i] or
+            tree.find_successor(queries[i]) != expected.successor[i] or
+            tree.rank(queries[i]) != expected.rank[i]) {
+          failures++;
+        }
+      }
+    }));
+  }
+  for (int t = 0; t < threads_count; t++) threads[t].join();
+}
+
+// answers the queries with find_predecessor_batch in threads_count threads at
+// once, each over the whole array
+template <class tree_type>
+static void check_batch_threads(const tree_type &tree,
+                                const vector<word> &queries,
+                                const answers &expected) {
+  vector<thread> threads;
+  for (int t = 0; t < threads_count; t++) {
+    threads.push_back(thread([&]() {
+      vector<int> out(queries.size());
+      tree.find_predecessor_batch(queries.data(), queries.size(), out.data());
+      if (out != expected.predecessor) failures++;
+    }));
+  }
+  for (int t = 0; t < threads_count; t++) threads[t].join();
+}
+
+// answers the queries with a pool over the tree, several jobs in a row
+template <class tree_type>
+static void check_pool(const tree_type &tree, const vector<word> &queries,
+                       const answers &expected) {
+  basic_query_pool<tree_type, word> pool(tree, threads_count);
+  for (int job = 0; job < 3; job++) {
+    vector<int> out(queries.size(), -2);
+    pool.find_predecessor(queries.data(), queries.size(), out.data());
+    if (out != expected.predecessor) failures++;
+  }
+}
+
+int main() {
+  env_type env(1024, 256, 3);
+  mt19937_64 rng(2021);
+
+  vector<word> elements;
+  for (int i = 0; i < 300; i++) elements.push_back(random_word<word>(rng, 256));
+  // half of the queries are elements, so that they hit them exactly
+  vector<word> queries;
+  for (int i = 0; i < 1000; i++) {
+    queries.push_back(i % 2 ? elements[rng() % elements.size()]
+                            : random_word<word>(rng, 256));
+  }
+
+  vector<word> node_elements(elements.begin(),
+                             elements.begin() + env.capacity);
+  const fusiontree_type node(node_elements, &env);
+  answers node_answers = serial_answers(node, queries);
+  check_threads(node, queries, node_answers);
+  check_batch_threads(node, queries, node_answers);
+  check_pool(node, queries, node_answers);
+
+  const btree_type tree(elements, &env);
+  answers tree_answers = serial_answers(tree, queries);
+  check_threads(tree, queries, tree_answers);
+  check_batch_threads(tree, queries, tree_answers);
+  check_pool(tree, queries, tree_answers);
+
+  if (failures > 0) {
+    fprintf(stderr, "%d wrong answers\n", failures.load());
+    return 1;
+  }
+  printf("test_concurrency: ok\n");
+  return 0;
+}
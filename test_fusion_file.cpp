@@ -0,0 +1,254 @@
+//
+//  test_fusion_file.cpp
+//  Fusion Tree
+//
+//  saves fusion trees and B-trees, after building them and after changing
+//  them with insert and erase, maps them back and checks their answers. Then
+//  corrupts fields and words of the saved files, which must be rejected with a
+//  string instead of being used, with exact and approximate sketches
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusion_file.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+typedef basic_fusiontree<word, env_type> fusiontree_type;
+typedef basic_fusion_btree<word, env_type> btree_type;
+
+static const char *node_path = "test_fusion_file_node.fus";
+static const char *btree_path = "test_fusion_file_btree.fus";
+
+// returns the bytes of a file
+static vector<char> read_bytes(const char *path) {
+  vector<char> bytes;
+  FILE *file = fopen(path, "rb");
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + read);
+  }
+  fclose(file);
+  return bytes;
+}
+
+static void write_bytes(const char *path, const vector<char> &bytes) {
+  FILE *file = fopen(path, "wb");
+  fwrite(bytes.data(), 1, bytes.size(), file);
+  fclose(file);
+}
+
+// checks that a tree read from a file answers as the tree it was saved from
+template <class tree_type>
+static void check_same(const tree_type &saved, const tree_type &loaded,
+                       const vector<word> &queries, const char *what) {
+  if (saved.size() != loaded.size()) return fail(what);
+  for (int i = 0; i < (int)queries.size(); i++) {
+    if (saved.find_predecessor(queries[i]) !=
+        loaded.find_predecessor(queries[i])) {
+      return fail(what);
+    }
+  }
+}
+
+// writes bytes, with the 64-bit field at offset replaced by value, and
+// checks that reading it as a tree of type tree_type throws a string
+template <class tree_type>
+static void check_rejected(vector<char> bytes, size_t offset, uint64_t value,
+                           const char *path, const env_type *env,
+                           const char *what) {
+  memcpy(&bytes[offset], &value, sizeof(value));
+  write_bytes(path, bytes);
+  try {
+    mapped_file file(path);
+    tree_type tree(file, env);
+    fail(what);
+  } catch (string &) {
+  }
+}
+
+// writes bytes, with count bytes from offset replaced by zeroes, and checks
+// that reading it as a tree of type tree_type throws a string
+template <class tree_type>
+static void check_zeroed_rejected(vector<char> bytes, size_t offset,
+                                  size_t count, const char *path,
+                                  const env_type *env, const char *what) {
+  memset(&bytes[offset], 0, count);
+  write_bytes(path, bytes);
+  try {
+    mapped_file file(path);
+    tree_type tree(file, env);
+    fail(what);
+  } catch (string &) {
+  }
+}
+
+// saves a node over env with the given elements, checks that it is read back
+// as it was saved, and that its words are rejected if they are not the ones its
+// elements lead to. The masks follow the record header, then come the indices
+// of the important bits and of m, the lanes and the elements
+static void check_node_words(vector<word> elements, const env_type *env) {
+  fusiontree_type node(elements, env);
+  node.save(node_path);
+  {
+    mapped_file file(node_path);
+    fusiontree_type loaded(file, env);
+    if (loaded.get_sketch_mode() != env->sketching) {
+      fail("a saved node has other sketches");
+    }
+  }
+  vector<char> bytes = read_bytes(node_path);
+  size_t record = sizeof(fusion_file_header);
+  size_t field = sizeof(uint64_t);
+  const fusion_node_header *header =
+      (const fusion_node_header *)&bytes[record];
+  size_t masks = record + sizeof(fusion_node_header);
+  size_t indices = masks + 5 * sizeof(word);
+  size_t lanes =
+      indices + (header->important_bits_count + header->m_count) * field;
+  size_t last_element = lanes + header->lane_count * field +
+                        (header->size - 1) * sizeof(word);
+  check_zeroed_rejected<fusiontree_type>(bytes, masks, sizeof(word), node_path,
+                                         env, "a zeroed data was accepted");
+  check_zeroed_rejected<fusiontree_type>(
+      bytes, masks + 3 * sizeof(word), sizeof(word), node_path, env,
+      "zeroed important bits were accepted");
+  if (header->exact_sketches) {
+    // m, sketch_mask and sketch_shift are not used, and must be zero
+    check_rejected<fusiontree_type>(bytes, masks + 4 * sizeof(word), 1,
+                                    node_path, env,
+                                    "an m with exact sketches was accepted");
+    check_rejected<fusiontree_type>(
+        bytes, masks + 2 * sizeof(word), 1, node_path, env,
+        "a sketch mask with exact sketches was accepted");
+    check_rejected<fusiontree_type>(
+        bytes, record + 5 * field, 1, node_path, env,
+        "a sketch shift with exact sketches was accepted");
+  } else {
+    check_rejected<fusiontree_type>(bytes, masks + 2 * sizeof(word), 1,
+                                    node_path, env,
+                                    "a wrong sketch mask was accepted");
+    // the last set bit of m moves up by one, in m and in its index, so only
+    // the sums of the important bits and m tell it apart
+    size_t last_m = indices + (2 * header->important_bits_count - 1) * field;
+    uint64_t m_bit;
+    memcpy(&m_bit, &bytes[last_m], sizeof(m_bit));
+    vector<char> moved = bytes;
+    uint64_t *m = (uint64_t *)&moved[masks + 4 * sizeof(word)];
+    m[m_bit / 64] &= ~(uint64_t(1) << (m_bit % 64));
+    m[(m_bit + 1) / 64] |= uint64_t(1) << ((m_bit + 1) % 64);
+    check_rejected<fusiontree_type>(moved, last_m, m_bit + 1, node_path, env,
+                                    "an m that does not lead to the sketch "
+                                    "mask was accepted");
+  }
+  if (header->lane_count > 0) {
+    check_rejected<fusiontree_type>(bytes, lanes, INT64_MAX, node_path, env,
+                                    "a missing lane was accepted");
+  }
+  check_rejected<fusiontree_type>(bytes, last_element + 4 * field, 1,
+                                  node_path, env,
+                                  "an element beyond the element size was "
+                                  "accepted");
+}
+
+int main() {
+  env_type env(1024, 256, 3);
+  mt19937_64 rng(2021);
+  vector<word> queries;
+  for (int i = 0; i < 200; i++) queries.push_back(random_word<word>(rng, 256));
+
+  // nodes of every size, built and then changed
+  for (int n = 0; n <= env.capacity; n++) {
+    vector<word> elements(queries.begin(), queries.begin() + n);
+    fusiontree_type node(elements, &env);
+    for (int step = 0; step < 2; step++) {
+      node.save(node_path);
+      mapped_file file(node_path);
+      fusiontree_type loaded(file, &env);
+      check_same(node, loaded, queries, "a saved node answers differently");
+      if (node.size() > 0) node.erase(node.pos(0));
+      node.insert(queries[100 + n]);
+    }
+  }
+
+  // a B-tree, built and then changed
+  vector<word> elements(queries.begin(), queries.begin() + 50);
+  btree_type tree(elements, &env);
+  for (int step = 0; step < 2; step++) {
+    tree.save(btree_path);
+    mapped_file file(btree_path);
+    btree_type loaded(file, &env);
+    check_same(tree, loaded, queries, "a saved B-tree answers differently");
+    for (int i = 0; i < 20; i++) tree.erase(queries[i]);
+    for (int i = 150; i < 170; i++) tree.insert(queries[i]);
+  }
+
+  // fields of a node record, after the file header
+  vector<word> node_elements(queries.begin(), queries.begin() + 3);
+  fusiontree_type node(node_elements, &env);
+  node.save(node_path);
+  vector<char> bytes = read_bytes(node_path);
+  size_t record = sizeof(fusion_file_header);
+  size_t field = sizeof(uint64_t);
+  check_rejected<fusiontree_type>(bytes, record + 2 * field, 5, node_path, &env,
+                                  "too many important bits were accepted");
+  check_rejected<fusiontree_type>(bytes, record + 4 * field, 100000, node_path,
+                                  &env, "a wrong sketch size was accepted");
+  check_rejected<fusiontree_type>(
+      bytes, record + 5 * field, 1 << 20, node_path, &env,
+      "a sketch shift beyond the word was accepted");
+  check_rejected<fusiontree_type>(bytes, record + 6 * field, 2, node_path,
+                                  &env, "exact_sketches = 2 was accepted");
+  check_rejected<fusiontree_type>(bytes, record + 7 * field, 1, node_path,
+                                  &env, "a wrong lane count was accepted");
+
+  // words of node records, with exact and approximate sketches
+  env_type exact_env(1024, 256, 3, exact_sketching);
+  env_type approximate_env(1024, 256, 3, approximate_sketching);
+  vector<word> pair_elements(queries.begin(), queries.begin() + 2);
+  check_node_words(pair_elements, &exact_env);
+  check_node_words(pair_elements, &approximate_env);
+  vector<word> full_elements(queries.begin(), queries.begin() + 3);
+  check_node_words(full_elements, &approximate_env);
+
+  // fields of the B-tree header and of its root entry
+  tree.save(btree_path);
+  bytes = read_bytes(btree_path);
+  size_t btree = sizeof(fusion_file_header);
+  size_t root_entry = btree + sizeof(fusion_btree_header);
+  check_rejected<btree_type>(bytes, btree + field, tree.levels() + 1,
+                             btree_path, &env, "a wrong height was accepted");
+  check_rejected<btree_type>(bytes, btree, tree.size() + 1, btree_path, &env,
+                             "a wrong size was accepted");
+  check_rejected<btree_type>(bytes, root_entry + field, tree.size() - 1,
+                             btree_path, &env,
+                             "a wrong count of the root was accepted");
+
+  // a number of entries whose size wraps around, with a root that claims more
+  // children than the entries that fit in the file
+  vector<word> small_elements(queries.begin(), queries.begin() + 2);
+  btree_type small_tree(small_elements, &env);
+  small_tree.save(btree_path);
+  bytes = read_bytes(btree_path);
+  uint64_t node_count = (uint64_t(1) << 59) + 1;
+  memcpy(&bytes[btree + 2 * field], &node_count, sizeof(node_count));
+  check_rejected<btree_type>(bytes, root_entry + 3 * field, 3, btree_path,
+                             &env, "a wrapping number of nodes was accepted");
+
+  remove(node_path);
+  remove(btree_path);
+  if (failures > 0) return 1;
+  printf("test_fusion_file: ok\n");
+  return 0;
+}
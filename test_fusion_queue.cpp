@@ -0,0 +1,169 @@
+//
+//  test_fusion_queue.cpp
+//  Fusion Tree
+//
+//  checks fusion_queue against a std::multiset of the priorities of its
+//  entries, over random pushes, pops and decrease_key calls with many repeated
+//  priorities, including decreases to the current minimum and handles given
+//  again after a pop. Then checks that the errors are thrown: an empty queue,
+//  a priority wider than the element size, and a wrong handle or increasing
+//  priority in decrease_key
+//
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_queue.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+typedef basic_fusion_queue<word, env_type> queue_type;
+
+static void fail(const char *what, int step) {
+  fprintf(stderr, "%s, at step %d\n", what, step);
+  failures++;
+}
+
+// checks that the queue has the entries of expected, whose priorities are
+// kept for each live handle in priorities
+static void check(const queue_type &queue, const multiset<int> &expected,
+                  const vector<int> &priorities, int step) {
+  if (queue.size() != (int)expected.size() or
+      queue.empty() != expected.empty()) {
+    return fail("wrong size", step);
+  }
+  if (expected.empty()) return;
+  if (queue.peek_min() != word(*expected.begin())) {
+    return fail("wrong minimum", step);
+  }
+  int handle = queue.min_handle();
+  if (priorities[handle] != *expected.begin() or
+      queue.priority(handle) != word(*expected.begin())) {
+    return fail("the handle of the minimum has another priority", step);
+  }
+}
+
+// returns true if calling f throws a string
+template <class function_type>
+static bool throws(function_type f) {
+  try {
+    f();
+  } catch (string &) {
+    return true;
+  }
+  return false;
+}
+
+// random pushes, pops and decreases of priorities below range
+static void test_random(const env_type &env, mt19937 &rng) {
+  const int range = 50;
+  queue_type queue(&env);
+  multiset<int> expected;
+  vector<int> priorities;  // priority of each handle, -1 if it is free
+  vector<int> live;        // handles in the queue
+  vector<int> popped;      // handles popped since the last push
+
+  for (int step = 0; step < 3000 and failures == 0; step++) {
+    int op = rng() % 10;
+    if (op < 4 or live.empty()) {
+      int p = rng() % range;
+      int handle = queue.push(word(p));
+      // a popped handle must be given again before a new one
+      if (!popped.empty() and handle != popped.back()) {
+        fail("a popped handle was not given again", step);
+      }
+      if (!popped.empty()) popped.pop_back();
+      if (handle >= (int)priorities.size()) priorities.resize(handle + 1, -1);
+      if (priorities[handle] != -1) fail("push gave a live handle", step);
+      priorities[handle] = p;
+      live.push_back(handle);
+      expected.insert(p);
+    } else if (op < 7) {
+      int handle = queue.pop_min();
+      if (handle < 0 or handle >= (int)priorities.size() or
+          priorities[handle] != *expected.begin()) {
+        fail("pop_min removed an entry without the smallest priority", step);
+        return;
+      }
+      expected.erase(expected.begin());
+      priorities[handle] = -1;
+      live.erase(find(live.begin(), live.end(), handle));
+      popped.push_back(handle);
+    } else {
+      int handle = live[rng() % live.size()];
+      int old_priority = priorities[handle];
+      // a third of the decreases go to the current minimum
+      int p = op == 7 ? *expected.begin() : rng() % (old_priority + 1);
+      if (p > old_priority) p = old_priority;
+      queue.decrease_key(handle, word(p));
+      expected.erase(expected.find(old_priority));
+      expected.insert(p);
+      priorities[handle] = p;
+    }
+    check(queue, expected, priorities, step);
+  }
+
+  // the queue is emptied in order
+  int last = -1;
+  while (!queue.empty() and failures == 0) {
+    int p = int(queue.priority(queue.min_handle()).limb(0));
+    if (p < last) fail("the priorities were popped out of order", -1);
+    last = p;
+    queue.pop_min();
+  }
+}
+
+// every error of the queue is thrown as a string
+static void test_errors(const env_type &env) {
+  queue_type queue(&env);
+  if (!throws([&] { queue.peek_min(); }) or
+      !throws([&] { queue.min_handle(); }) or
+      !throws([&] { queue.pop_min(); })) {
+    fail("an empty queue did not throw", -1);
+  }
+  if (!throws([&] { queue.push(word(1) << env.element_size); }) or
+      queue.size() != 0) {
+    fail("a priority wider than the element size was pushed", -1);
+  }
+  if (throws([&] { queue.push((word(1) << env.element_size) - word(1)); })) {
+    fail("a priority of the element size was rejected", -1);
+  }
+
+  int handle = queue.push(word(10));
+  if (!throws([&] { queue.decrease_key(handle, word(11)); }) or
+      queue.priority(handle) != word(10)) {
+    fail("decrease_key increased a priority", -1);
+  }
+  queue.decrease_key(handle, word(10));
+  if (!throws([&] { queue.decrease_key(-1, word(0)); }) or
+      !throws([&] { queue.decrease_key(handle + 100, word(0)); }) or
+      !throws([&] { queue.priority(handle + 100); })) {
+    fail("a handle out of the queue was accepted", -1);
+  }
+  queue.pop_min();
+  queue.pop_min();
+  if (!throws([&] { queue.decrease_key(handle, word(0)); }) or
+      !throws([&] { queue.priority(handle); })) {
+    fail("a popped handle was accepted", -1);
+  }
+}
+
+int main() {
+  env_type env(1024, 256, 3);
+  mt19937 rng(2021);
+  test_random(env, rng);
+  test_errors(env);
+  if (failures > 0) return 1;
+  printf("test_fusion_queue: ok\n");
+  return 0;
+}
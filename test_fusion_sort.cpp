@@ -0,0 +1,104 @@
+//
+//  test_fusion_sort.cpp
+//  Fusion Tree
+//
+//  checks fusion_sort against std::sort, on ranges shorter and longer than
+//  FUSION_SORT_CUTOFF, with repeated keys, keys equal to the splitters and
+//  sorted and reversed inputs. Then checks that the sort over the default
+//  environment rejects a key wider than its elements
+//
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_sort.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef basic_big_int<1024> word;
+typedef basic_environment<word> env_type;
+
+// sorts keys with fusion_sort and with std::sort, and compares them
+static void check_sort(vector<word> keys, const env_type *env,
+                       const char *what) {
+  vector<word> expected = keys;
+  std::sort(expected.begin(), expected.end());
+  fusion_sort(keys, env);
+  if (keys != expected) {
+    fprintf(stderr, "%s: %d keys sorted wrongly\n", what, (int)keys.size());
+    failures++;
+  }
+}
+
+int main() {
+  env_type env(1024, 256, 3);
+  mt19937_64 rng(2021);
+
+  const int sizes[] = {0,  1,   2,   10,  FUSION_SORT_CUTOFF,
+                       FUSION_SORT_CUTOFF + 1, 300, 3000};
+  for (int n : sizes) {
+    // distinct keys with all their bits random
+    vector<word> keys;
+    for (int i = 0; i < n; i++) keys.push_back(random_word<word>(rng, 256));
+    check_sort(keys, &env, "random keys");
+
+    // the same keys, already sorted and reversed
+    std::sort(keys.begin(), keys.end());
+    check_sort(keys, &env, "sorted keys");
+    std::reverse(keys.begin(), keys.end());
+    check_sort(keys, &env, "reversed keys");
+
+    // a few distinct keys, so that many keys are equal to the splitters,
+    // which are sampled from the keys
+    keys.clear();
+    for (int i = 0; i < n; i++) keys.push_back(word(int(rng() % 7) * 1000));
+    check_sort(keys, &env, "repeated keys");
+
+    // every key equal
+    keys.assign(n, word(42));
+    check_sort(keys, &env, "equal keys");
+
+    // keys that share their high bits, and repetitions of some of them
+    keys.clear();
+    word prefix = random_word<word>(rng, 256) & ~((word(1) << 64) - word(1));
+    for (int i = 0; i < n; i++) {
+      keys.push_back(prefix | word(int(rng() % (n + 1))));
+    }
+    check_sort(keys, &env, "keys with a common prefix");
+  }
+
+  // the sort over the default environment, with keys of its element size
+  environment default_env;
+  vector<big_int> wide;
+  for (int i = 0; i < 200; i++) {
+    wide.push_back(random_word<big_int>(rng, default_env.element_size));
+    if (i % 5 == 4) wide.push_back(wide[i / 2]);
+  }
+  vector<big_int> expected = wide;
+  std::sort(expected.begin(), expected.end());
+  fusion_sort(wide);
+  if (wide != expected) {
+    fprintf(stderr, "default environment: keys sorted wrongly\n");
+    failures++;
+  }
+
+  // a key with a bit beyond the element size is rejected
+  wide.push_back(big_int(1) << default_env.element_size);
+  try {
+    fusion_sort(wide);
+    fprintf(stderr, "a key wider than the element size was accepted\n");
+    failures++;
+  } catch (string &) {
+  }
+
+  if (failures > 0) return 1;
+  printf("test_fusion_sort: ok\n");
+  return 0;
+}
@@ -0,0 +1,202 @@
+//
+//  test_op_counter.cpp
+//  Fusion Tree
+//
+//  checks the operation counters of op_counter.hpp: that an operation is
+//  attributed to the innermost site being run, that each thread snapshots
+//  only its own counts, that total adds up the counts of the threads that
+//  have finished, and the JSON output. Then counts a fixed query on a fixed
+//  node, which must make the operations listed below, and the same ones at
+//  every word size. Its counts are checked in a program built with "make
+//  COUNT_OPS=1 test", after "make clean"; otherwise the query must count
+//  nothing
+//
+
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusiontree.hpp"
+#include "op_counter.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+// checks that counts is zero everywhere but at the given site and kind, where
+// it is expected
+static void check_only(const op_counts &counts, op_site site, op_kind kind,
+                       uint64_t expected, const char *what) {
+  if (counts.count[site][kind] != expected or counts.total() != expected) {
+    fail(what);
+  }
+}
+
+// operations counted by hand inside nested scopes, in a thread of their own
+// so that they are the only counts of the thread
+static void test_sites() {
+  thread t([]() {
+    op_counter::count(op_add);
+    {
+      op_scope rank_scope(site_rank);
+      op_counter::count(op_mul);
+      {
+        op_scope first_diff_scope(site_first_diff);
+        op_counter::count(op_shift);
+        op_counter::count(op_shift);
+      }
+      op_counter::count(op_compare);
+    }
+    op_counter::count(op_logic);
+
+    op_counts counts = op_counter::thread_counts();
+    if (counts.count[site_other][op_add] != 1 or
+        counts.count[site_other][op_logic] != 1 or
+        counts.count[site_rank][op_mul] != 1 or
+        counts.count[site_rank][op_compare] != 1 or
+        counts.count[site_first_diff][op_shift] != 2 or counts.total() != 6) {
+      fail("an operation was not counted at the innermost site");
+    }
+    if (counts.site_total(site_rank) != 2 or
+        counts.kind_total(op_shift) != 2) {
+      fail("wrong totals of a site or of a kind");
+    }
+  });
+  t.join();
+}
+
+// two threads count at once. Each one sees only its own counts, and total
+// keeps them after the threads finish
+static void test_threads() {
+  op_counts before = op_counter::total();
+  op_counts first, second;
+  thread a([&]() {
+    op_scope scope(site_insert);
+    for (int i = 0; i < 1000; i++) op_counter::count(op_logic);
+    first = op_counter::thread_counts();
+  });
+  thread b([&]() {
+    op_scope scope(site_erase);
+    for (int i = 0; i < 500; i++) op_counter::count(op_add);
+    second = op_counter::thread_counts();
+  });
+  a.join();
+  b.join();
+  check_only(first, site_insert, op_logic, 1000,
+             "a thread saw counts other than its own");
+  check_only(second, site_erase, op_add, 500,
+             "a thread saw counts other than its own");
+
+  op_counts added = op_counter::total() - before;
+  if (added.count[site_insert][op_logic] != 1000 or
+      added.count[site_erase][op_add] != 500 or added.total() != 1500) {
+    fail("the counts of finished threads are not in the total");
+  }
+}
+
+// only the sites with some operation are written, with all their kinds
+static void test_json() {
+  op_counts counts;
+  counts.count[site_find_m][op_mul] = 3;
+  counts.count[site_erase][op_compare] = 12;
+  ostringstream out;
+  counts.print_json(out);
+  string expected =
+      "{\"find_m\": {\"mul\": 3, \"add\": 0, \"shift\": 0, \"logic\": 0, "
+      "\"compare\": 0}, \"erase\": {\"mul\": 0, \"add\": 0, \"shift\": 0, "
+      "\"logic\": 0, \"compare\": 12}}\n";
+  if (out.str() != expected) fail("wrong JSON output");
+
+  ostringstream empty;
+  op_counts().print_json(empty);
+  if (empty.str() != "{}\n") fail("wrong JSON output of no counts");
+}
+
+// returns the counts of the predecessor of 20 in the node {3, 9, 27}, with
+// approximate sketches compared in the word RAM, over words of Bits bits
+template <int Bits>
+static op_counts query_counts() {
+  typedef basic_big_int<Bits> word;
+  basic_environment<word> env(Bits, 256, 3, approximate_sketching);
+  vector<word> elements = {3, 9, 27};
+  basic_fusiontree<word> node(elements, &env);
+  node.set_search_mode(basic_fusiontree<word>::word_ram_search);
+  word x(20);
+  op_counts before = op_counter::thread_counts();
+  int answer = node.find_predecessor(x);
+  op_counts counts = op_counter::thread_counts() - before;
+  if (answer != 1) fail("wrong predecessor of the counted query");
+  return counts;
+}
+
+// counts of the query, by site and kind: mul, add, shift, logic and compare.
+// The word RAM most significant bit of the lca makes most of them, and a
+// program built with NAIVE=1 finds it with other operations
+static const struct {
+  op_site site;
+  uint64_t count[op_kind_count];
+} expected_counts[] = {
+    {site_find_predecessor, {0, 0, 0, 4, 3}},
+    {site_find_sketch_predecessor, {4, 2, 4, 6, 2}},
+    {site_approximate_sketch, {2, 0, 2, 4, 0}},
+    {site_most_significant_bit, {10, 6, 8, 26, 0}},
+    {site_first_diff, {0, 0, 0, 2, 0}},
+};
+
+// the query counts the expected operations, and the same ones at every word
+// size
+static void test_query() {
+  op_counts counts = query_counts<512>();
+#if COUNT_OPS
+#if !NAIVE
+  op_counts expected;
+  for (const auto &site : expected_counts) {
+    for (int j = 0; j < op_kind_count; j++) {
+      expected.count[site.site][j] = site.count[j];
+    }
+  }
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) {
+      if (counts.count[i][j] != expected.count[i][j]) {
+        fprintf(stderr, "%s at %s: %llu operations instead of %llu\n",
+                op_kind_name(j), op_site_name(i),
+                (unsigned long long)counts.count[i][j],
+                (unsigned long long)expected.count[i][j]);
+        failures++;
+      }
+    }
+  }
+#endif
+  if (counts.site_total(site_other) != 0) {
+    fail("the query counted outside its sites");
+  }
+  op_counts wider = query_counts<2048>();
+  for (int i = 0; i < op_site_count; i++) {
+    for (int j = 0; j < op_kind_count; j++) {
+      if (counts.count[i][j] != wider.count[i][j]) {
+        fprintf(stderr, "%s at %s: %llu operations with 512 bits and %llu "
+                        "with 2048 bits\n",
+                op_kind_name(j), op_site_name(i),
+                (unsigned long long)counts.count[i][j],
+                (unsigned long long)wider.count[i][j]);
+        failures++;
+      }
+    }
+  }
+#else
+  if (counts.total() != 0) fail("the query counted without COUNT_OPS");
+#endif
+}
+
+int main() {
+  test_sites();
+  test_threads();
+  test_json();
+  test_query();
+  if (failures > 0) return 1;
+  printf("test_op_counter: ok\n");
+  return 0;
+}
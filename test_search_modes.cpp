@@ -0,0 +1,146 @@
+//
+//  test_search_modes.cpp
+//  Fusion Tree
+//
+//  checks that fusion tree nodes answer the same queries in the three search
+//  modes, word_ram_search, lane_search and simd_search, and that the answers
+//  are the ones of std::set, before and after insertions and removals. The
+//  nodes are built with exact and approximate sketches, at every capacity from
+//  2 to 5: the approximate sketches of capacities 4 and 5 take 63 bits or more,
+//  so the lane modes fall back to the word RAM search. Also checks that
+//  simd_search is only accepted if the processor supports AVX2, and that a
+//  refused mode leaves the search mode as it was
+//
+
+#include <stdio.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+const char *mode_names[] = {"word_ram_search", "lane_search", "simd_search"};
+
+// checks the predecessors and ranks of the queries in every search mode the
+// processor supports against expected
+template <class word>
+static void check_modes(basic_fusiontree<word> &node, const set<word> &expected,
+                        const vector<word> &queries, const char *what) {
+  typedef basic_fusiontree<word> fusiontree_type;
+  vector<word> sorted(expected.begin(), expected.end());
+  typename fusiontree_type::search_mode old_mode = node.get_search_mode();
+  for (int m = 0; m < 3; m++) {
+    typename fusiontree_type::search_mode mode =
+        typename fusiontree_type::search_mode(m);
+    if (!node.set_search_mode(mode)) continue;
+    if (node.get_search_mode() != mode) {
+      fprintf(stderr, "%s: %s was not selected\n", what, mode_names[m]);
+      failures++;
+      return;
+    }
+    for (int i = 0; i < (int)queries.size(); i++) {
+      const word &x = queries[i];
+      int rank =
+          int(lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin());
+      int predecessor =
+          int(upper_bound(sorted.begin(), sorted.end(), x) - sorted.begin()) -
+          1;
+      if (node.find_predecessor(x) != predecessor or node.rank(x) != rank) {
+        fprintf(stderr, "%s: query %d answered wrongly in %s\n", what, i,
+                mode_names[m]);
+        failures++;
+        return;
+      }
+    }
+  }
+  node.set_search_mode(old_mode);
+}
+
+// nodes of every size, changed by random insertions and removals
+template <int Bits>
+static void test_random(int element_size, int capacity, sketch_mode sketching,
+                        mt19937_64 &rng) {
+  typedef basic_big_int<Bits> word;
+  basic_environment<word> env(Bits, element_size, capacity, sketching);
+
+  vector<word> keys, queries;
+  for (int i = 0; i < 12; i++) {
+    keys.push_back(random_word<word>(rng, element_size));
+  }
+  for (int i = 0; i < (int)keys.size(); i++) {
+    queries.push_back(keys[i]);
+    queries.push_back(keys[i] - word(1));
+    queries.push_back(random_word<word>(rng, element_size));
+  }
+
+  for (int n = 0; n <= capacity and failures == 0; n++) {
+    vector<word> elements(keys.begin(), keys.begin() + n);
+    set<word> expected(elements.begin(), elements.end());
+    basic_fusiontree<word> node(elements, &env);
+    check_modes(node, expected, queries, "node");
+
+    // the modes are changed between the updates, which must keep the lanes
+    // of every mode up to date
+    for (int step = 0; step < 20 and failures == 0; step++) {
+      node.set_search_mode(
+          typename basic_fusiontree<word>::search_mode(rng() % 2));
+      const word &x = keys[rng() % keys.size()];
+      if (rng() % 2) {
+        if ((int)expected.size() < capacity) expected.insert(x);
+        node.insert(x);
+      } else {
+        expected.erase(x);
+        node.erase(x);
+      }
+      check_modes(node, expected, queries, "changed node");
+    }
+  }
+}
+
+// simd_search is accepted only with AVX2. A refused mode changes nothing
+static void test_refused() {
+  typedef basic_big_int<512> word;
+  basic_environment<word> env(512, 256, 3);
+  vector<word> elements = {3, 9, 27};
+  basic_fusiontree<word> node(elements, &env);
+  if (!node.set_search_mode(basic_fusiontree<word>::lane_search)) {
+    fprintf(stderr, "lane_search was refused\n");
+    failures++;
+  }
+  bool accepted = node.set_search_mode(basic_fusiontree<word>::simd_search);
+  if (accepted != cpu_supports_avx2()) {
+    fprintf(stderr, "simd_search was %s\n", accepted ? "accepted" : "refused");
+    failures++;
+  }
+  basic_fusiontree<word>::search_mode expected_mode =
+      accepted ? basic_fusiontree<word>::simd_search
+               : basic_fusiontree<word>::lane_search;
+  if (node.get_search_mode() != expected_mode) {
+    fprintf(stderr, "the search mode is %s after simd_search was %s\n",
+            mode_names[node.get_search_mode()],
+            accepted ? "accepted" : "refused");
+    failures++;
+  }
+}
+
+int main() {
+  test_refused();
+  mt19937_64 rng(2021);
+  sketch_mode sketchings[] = {exact_sketching, approximate_sketching};
+  for (int trial = 0; trial < 3; trial++) {
+    for (sketch_mode sketching : sketchings) {
+      test_random<512>(64, 2, sketching, rng);
+      test_random<512>(256, 3, sketching, rng);
+      test_random<2048>(1024, 4, sketching, rng);
+      test_random<WSIZE>(3136, 5, sketching, rng);
+    }
+  }
+  if (failures > 0) return 1;
+  printf("test_search_modes: ok\n");
+  return 0;
+}
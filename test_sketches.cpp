@@ -0,0 +1,156 @@
+//
+//  test_sketches.cpp
+//  Fusion Tree
+//
+//  checks fusion trees and B-trees built with exact and with approximate
+//  sketches against std::set, at every capacity from 2 to 5, each with the
+//  smallest word that fits it. The keys take the whole element size, and the
+//  trees are checked after each of many random insertions and removals. With
+//  approximate sketches this runs find_m, the multiplication by m and the
+//  parallel comparison of sketches of up to (important bits)^4 bits, which
+//  the default sketches skip on processors with BMI2. Both are also built with
+//  pairwise_construction, the construction of the first version
+//
+
+#include <stdio.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+const char *sketch_names[] = {"auto", "exact", "approximate"};
+
+// checks that the tree keeps the elements of expected, and answers the
+// predecessor, successor and rank of each query as expected does
+template <class word, class tree_type>
+static void check(const tree_type &tree, const set<word> &expected,
+                  const vector<word> &queries, const char *what,
+                  sketch_mode mode) {
+  vector<word> sorted(expected.begin(), expected.end());
+  if (tree.size() != (int)sorted.size()) {
+    fprintf(stderr, "%s, %s sketches: size %d instead of %d\n", what,
+            sketch_names[mode], tree.size(), (int)sorted.size());
+    failures++;
+    return;
+  }
+  for (int i = 0; i < (int)queries.size(); i++) {
+    const word &x = queries[i];
+    int rank =
+        int(lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin());
+    int predecessor =
+        int(upper_bound(sorted.begin(), sorted.end(), x) - sorted.begin()) - 1;
+    int successor = rank < (int)sorted.size() ? rank : -1;
+    if (tree.find_predecessor(x) != predecessor or
+        tree.find_successor(x) != successor or tree.rank(x) != rank) {
+      fprintf(stderr, "%s, %s sketches: query %d answered wrongly\n", what,
+              sketch_names[mode], i);
+      failures++;
+      return;
+    }
+  }
+}
+
+// random insertions and removals in a single node and in a B-tree, checked
+// after each of them. The queries are the keys, the keys plus one and random
+// integers
+template <int Bits>
+static void test_random(int element_size, int capacity, sketch_mode mode,
+                        construction_mode construction, mt19937_64 &rng) {
+  typedef basic_big_int<Bits> word;
+  basic_environment<word> env(Bits, element_size, capacity, mode,
+                              construction);
+
+  vector<word> keys, queries;
+  for (int i = 0; i < 30; i++) {
+    keys.push_back(random_word<word>(rng, element_size));
+  }
+  for (int i = 0; i < (int)keys.size(); i++) {
+    queries.push_back(keys[i]);
+    queries.push_back(keys[i] + word(1));
+    queries.push_back(random_word<word>(rng, element_size));
+  }
+
+  for (int n = 0; n <= capacity and failures == 0; n++) {
+    vector<word> elements(keys.begin(), keys.begin() + n);
+    set<word> expected(elements.begin(), elements.end());
+    basic_fusiontree<word> node(elements, &env);
+    if (node.get_sketch_mode() != mode) {
+      fprintf(stderr, "a node has %s sketches instead of %s\n",
+              sketch_names[node.get_sketch_mode()], sketch_names[mode]);
+      failures++;
+      return;
+    }
+    check(node, expected, queries, "node", mode);
+
+    for (int step = 0; step < 40 and failures == 0; step++) {
+      const word &x = keys[rng() % 8];
+      if (rng() % 2) {
+        bool inserted = (int)expected.size() < capacity and
+                        expected.insert(x).second;
+        if (node.insert(x) != inserted) {
+          fprintf(stderr, "node, %s sketches: wrong result of insert\n",
+                  sketch_names[mode]);
+          failures++;
+        }
+      } else {
+        bool erased = expected.erase(x) > 0;
+        if (node.erase(x) != erased) {
+          fprintf(stderr, "node, %s sketches: wrong result of erase\n",
+                  sketch_names[mode]);
+          failures++;
+        }
+      }
+      check(node, expected, queries, "changed node", mode);
+    }
+  }
+
+  vector<word> elements(keys.begin(), keys.begin() + 15);
+  set<word> expected(elements.begin(), elements.end());
+  basic_fusion_btree<word> tree(elements, &env);
+  check(tree, expected, queries, "B-tree", mode);
+  for (int step = 0; step < 100 and failures == 0; step++) {
+    const word &x = keys[rng() % keys.size()];
+    if (rng() % 2) {
+      bool inserted = expected.insert(x).second;
+      if (tree.insert(x) != inserted) {
+        fprintf(stderr, "B-tree, %s sketches: wrong result of insert\n",
+                sketch_names[mode]);
+        failures++;
+      }
+    } else {
+      bool erased = expected.erase(x) > 0;
+      if (tree.erase(x) != erased) {
+        fprintf(stderr, "B-tree, %s sketches: wrong result of erase\n",
+                sketch_names[mode]);
+        failures++;
+      }
+    }
+    check(tree, expected, queries, "changed B-tree", mode);
+  }
+}
+
+int main() {
+  mt19937_64 rng(2021);
+  sketch_mode modes[] = {exact_sketching, approximate_sketching};
+  for (int trial = 0; trial < 3; trial++) {
+    // the last trial uses the construction of the first version
+    construction_mode construction =
+        trial < 2 ? adjacent_construction : pairwise_construction;
+    for (sketch_mode mode : modes) {
+      test_random<512>(64, 2, mode, construction, rng);
+      test_random<512>(256, 3, mode, construction, rng);
+      test_random<2048>(1024, 4, mode, construction, rng);
+      test_random<WSIZE>(3136, 5, mode, construction, rng);
+    }
+  }
+  if (failures > 0) return 1;
+  printf("test_sketches: ok\n");
+  return 0;
+}
@@ -0,0 +1,139 @@
+//
+//  test_static_environment.cpp
+//  Fusion Tree
+//
+//  builds fusion trees and B-trees over static_environment<512, 256, 3>, as in
+//  the README, and over basic_environment<basic_big_int<512> >(512, 256, 3),
+//  with the same elements, and checks that they answer every query in the
+//  same way, also after insertions and removals. Also checks the bitmasks
+//  that static_environment computes from their index, and its most
+//  significant bit, whose bitmasks are found at compile time
+//
+
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+#include "big_int.hpp"
+#include "fusion_btree.hpp"
+#include "fusiontree.hpp"
+#include "static_environment.hpp"
+#include "test_util.hpp"
+
+using namespace std;
+
+typedef static_environment<512, 256, 3> static_env;
+typedef static_env::word word;
+typedef basic_environment<word> dynamic_env;
+
+// checks that two trees, over the two environments, keep the same elements and
+// answer the queries in the same way
+template <class static_tree, class dynamic_tree>
+static void check_same(const static_tree &a, const dynamic_tree &b,
+                       const vector<word> &queries, const char *what) {
+  if (a.size() != b.size()) {
+    fprintf(stderr, "%s: size %d instead of %d\n", what, a.size(), b.size());
+    failures++;
+    return;
+  }
+  for (int i = 0; i < a.size(); i++) {
+    if (a.pos(i) != b.pos(i)) {
+      fprintf(stderr, "%s: wrong element of rank %d\n", what, i);
+      failures++;
+      return;
+    }
+  }
+  for (int i = 0; i < (int)queries.size(); i++) {
+    const word &x = queries[i];
+    const word &y = queries[(i + 1) % queries.size()];
+    if (a.find_predecessor(x) != b.find_predecessor(x) or
+        a.find_successor(x) != b.find_successor(x) or
+        a.rank(x) != b.rank(x) or a.count_range(x, y) != b.count_range(x, y)) {
+      fprintf(stderr, "%s: query %d answered differently\n", what, i);
+      failures++;
+      return;
+    }
+  }
+}
+
+// the bitmasks of static_environment are the ones of the tables of
+// basic_environment, and give the same most significant bits
+static void check_masks(const static_env &senv, const dynamic_env &denv,
+                        mt19937_64 &rng) {
+  for (int i = 0; i < senv.word_size; i++) {
+    if (senv.shift_1[i] != denv.shift_1[i] or
+        senv.shift_neg_1[i] != denv.shift_neg_1[i] or
+        senv.shift_neg_0[i] != denv.shift_neg_0[i] or
+        word(~senv.shift_neg_0[i]) != ~denv.shift_neg_0[i]) {
+      fprintf(stderr, "bitmasks of index %d are different\n", i);
+      failures++;
+      return;
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    word x = random_word<word>(rng, rng() % (senv.element_size + 1));
+    if (senv.word_ram_most_significant_bit(x) !=
+        denv.word_ram_most_significant_bit(x)) {
+      fprintf(stderr, "most significant bits are different\n");
+      failures++;
+      return;
+    }
+  }
+}
+
+int main() {
+  static_env *senv = new static_env;
+  dynamic_env *denv = new dynamic_env(512, 256, 3);
+  mt19937_64 rng(2021);
+  check_masks(*senv, *denv, rng);
+
+  // the queries include the elements, and integers next to them
+  vector<word> elements, queries;
+  for (int i = 0; i < 200; i++) {
+    elements.push_back(random_word<word>(rng, senv->element_size));
+  }
+  for (int i = 0; i < 200; i++) {
+    queries.push_back(random_word<word>(rng, senv->element_size));
+    queries.push_back(elements[i]);
+    queries.push_back(elements[i] + word(1));
+  }
+
+  // nodes of every size
+  for (int n = 0; n <= senv->capacity; n++) {
+    vector<word> a(elements.begin(), elements.begin() + n), b = a;
+    basic_fusiontree<word, static_env> static_node(a, senv);
+    basic_fusiontree<word, dynamic_env> dynamic_node(b, denv);
+    check_same(static_node, dynamic_node, queries, "node");
+    if (n > 0) {
+      static_node.erase(elements[0]);
+      dynamic_node.erase(elements[0]);
+      static_node.insert(elements[100]);
+      dynamic_node.insert(elements[100]);
+      check_same(static_node, dynamic_node, queries, "changed node");
+    }
+  }
+
+  // B-trees, built and then changed
+  vector<word> a(elements.begin(), elements.begin() + 100), b = a;
+  basic_fusion_btree<word, static_env> static_tree(a, senv);
+  basic_fusion_btree<word, dynamic_env> dynamic_tree(b, denv);
+  check_same(static_tree, dynamic_tree, queries, "B-tree");
+  for (int i = 0; i < 50; i++) {
+    static_tree.erase(elements[2 * i]);
+    dynamic_tree.erase(elements[2 * i]);
+    static_tree.insert(elements[100 + i]);
+    dynamic_tree.insert(elements[100 + i]);
+  }
+  check_same(static_tree, dynamic_tree, queries, "changed B-tree");
+  if (static_tree.levels() != dynamic_tree.levels()) {
+    fprintf(stderr, "the B-trees have different heights\n");
+    failures++;
+  }
+
+  delete senv;
+  delete denv;
+  if (failures > 0) return 1;
+  printf("test_static_environment: ok\n");
+  return 0;
+}
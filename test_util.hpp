@@ -0,0 +1,38 @@
+//
+//  test_util.hpp
+//  Fusion Tree
+//
+
+#ifndef test_util_hpp
+#define test_util_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <random>
+
+using namespace std;
+
+// helpers shared by the tests, in the files test_*.cpp. Each test is linked
+// as its own program, so each one has its own counter of failed checks, and
+// returns 1 from main if it is not zero
+
+// number of failed checks, from any thread
+static atomic<int> failures(0);
+
+// reports a failed check
+static inline void fail(const char *what) {
+  fprintf(stderr, "%s\n", what);
+  failures++;
+}
+
+// returns a random integer of type word below 2^bits
+template <class word>
+static word random_word(mt19937_64 &rng, int bits) {
+  uint64_t limbs[word::limb_count];
+  for (int i = 0; i < word::limb_count; i++) limbs[i] = rng();
+  return word(limbs, word::limb_count) & ((word(1) << bits) - word(1));
+}
+
+#endif /* test_util_hpp */
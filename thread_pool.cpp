@@ -0,0 +1,80 @@
+//
+//  thread_pool.cpp
+//  Fusion Tree
+//
+
+#include "thread_pool.hpp"
+
+// loop of each thread of the pool
+
+void thread_pool::work(int worker) {
+  long long seen_job = 0;  // last job this thread worked on
+
+  while (true) {
+    const function<void(int)> *job_task;
+    {
+      unique_lock<mutex> guard(lock);
+      while (not stopping and job == seen_job) job_ready.wait(guard);
+      if (stopping) return;
+      seen_job = job;
+      job_task = task;
+    }
+
+    // the task is not changed until every thread reports it is done, so it is
+    // run without the lock
+    (*job_task)(worker);
+
+    {
+      lock_guard<mutex> guard(lock);
+      busy_workers--;
+      if (busy_workers == 0) job_done.notify_one();
+    }
+  }
+}
+
+// returns the number of threads in the pool
+
+const int thread_pool::size() const { return workers.size(); }
+
+// runs a task in all the threads of the pool
+
+void thread_pool::run(const function<void(int)> &task_) {
+  lock_guard<mutex> caller(job_lock);
+  unique_lock<mutex> guard(lock);
+
+  task = &task_;
+  busy_workers = workers.size();
+  job++;
+  job_ready.notify_all();
+
+  while (busy_workers > 0) job_done.wait(guard);
+  task = NULL;
+}
+
+// pool constructor
+
+thread_pool::thread_pool(int threads_) {
+  task = NULL;
+  job = 0;
+  busy_workers = 0;
+  stopping = false;
+
+  if (threads_ <= 0) threads_ = thread::hardware_concurrency();
+  if (threads_ <= 0) threads_ = 1;
+
+  for (int i = 0; i < threads_; i++) {
+    workers.push_back(thread(&thread_pool::work, this, i));
+  }
+}
+
+// pool destructor
+
+thread_pool::~thread_pool() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  job_ready.notify_all();
+
+  for (int i = 0; i < (int)workers.size(); i++) workers[i].join();
+}
@@ -0,0 +1,60 @@
+//
+//  thread_pool.hpp
+//  Fusion Tree
+//
+
+#ifndef thread_pool_hpp
+#define thread_pool_hpp
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// pool of threads that run the same task at once, one job at a time. The
+// threads wait for a job, each of them runs the task of the job once, and the
+// caller wakes when all of them are done. The task usually takes pieces of the
+// work from an atomic counter until none is left, so faster threads take more
+// of them. basic_query_pool and basic_bulk_builder run their jobs on it
+class thread_pool {
+ private:
+  vector<thread> workers;  // threads of the pool
+
+  mutex job_lock;  // lets a single caller use the pool at a time
+  mutex lock;  // guards the variables below
+  condition_variable job_ready;  // wakes the threads for a job or to stop
+  condition_variable job_done;  // wakes the caller when the job is finished
+
+  const function<void(int)> *task;  // task of the current job
+  long long job;  // number of the current job, so that a thread takes it once
+  int busy_workers;  // threads still working on the current job
+  bool stopping;  // true when the pool is destroyed
+
+  // loop of thread worker: waits for a job, runs its task, and reports that
+  // it is done
+  void work(int worker);
+
+  // a pool owns its threads, so it cannot be copied
+  thread_pool(const thread_pool &);
+  thread_pool &operator=(const thread_pool &);
+
+ public:
+  // number of threads in the pool
+  const int size() const;
+
+  // calls task_(i) in the thread i of the pool, for 0<=i<size(), and blocks
+  // until all the calls return. The task must not throw
+  void run(const function<void(int)> &task_);
+
+  // pool constructor
+  // starts threads_ threads, or one per hardware thread if threads_ is 0
+  explicit thread_pool(int threads_ = 0);
+
+  // pool destructor. Stops and joins the threads
+  ~thread_pool();
+};
+
+#endif /* thread_pool_hpp */